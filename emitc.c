@@ -0,0 +1,1313 @@
+/*  emitc.c : translate a program to C, for tbasic --emit-c
+
+ The program is compiled (see compile() in tbasic.c) and each statement
+ becomes a few lines of C in main(). Variables A-Z are locals, every
+ line has a label and GOTO is a goto. FOR and GOSUB push the same stack
+ frames as the interpreter, holding the number of the line to go back
+ to, and NEXT and RETURN walk them the same way. Arrays, DATA and files
+ stay where the interpreter keeps them and everything but arithmetic
+ and control flow is done by calling tbasic.c and host.c, so the
+ translated program prints exactly what the interpreted one does,
+ errors included. Arithmetic is done in int and cut back to 16 bits
+ after every operation.
+
+ The program text goes into the translation too: it is loaded into
+ memory[] at startup so that PEEK(), FRE() and the run image are laid
+ out just as they are in the interpreter. The variables are copied to
+ and from memory[] around statements that can see them there.
+
+ The result is built with tbasic.c compiled with -DNOMAIN, ir.c, jit.c
+ and host.c:
+	tbasic --emit-c prog.bas > prog.c
+	gcc -O2 prog.c tbrt.o ir.o jit.o host.o -lpthread
+ or use make prog.native.
+*/
+
+#include <stdio.h>
+#include "host.h"
+#include "tbasic.h"
+
+#define F_FAIL   1  /* can set exp_error */
+#define F_EFFECT 2  /* does something besides giving a value */
+#define F_MEM    4  /* reads memory[], which may hold the variables */
+#define CAREFUL (F_FAIL|F_EFFECT)
+
+FILE *out;
+uchar eflag[CMP_NODES];
+short int etemp[CMP_NODES];  /* temporary holding the value of a node, or -1 */
+short int ntemps;            /* temporaries used by the current statement */
+short int maxtemps;
+uchar maybe_err;             /* exp_error may be set at this point of the statement */
+short int depth;             /* indent */
+short int eline[CMP_STMTS+1];   /* line number of each statement, counting from 0 */
+short int nlines;
+
+/* C helpers that go at the top of every translation */
+char *prelude[] = {
+	"/* an element of array n, A(i) or A(i,j), as arr_index(); 0 with",
+	" * exp_error set if it is out of bounds. With c set, an error earlier",
+	" * in the statement makes it fail quietly.",
+	" */",
+	"uchar *x_ref(c, n, two, i, j)",
+	"int c;",
+	"int n;",
+	"int two;",
+	"short int i;",
+	"short int j;",
+	"{",
+	"\tunsigned int siz = ((short int *)array_sz)[n];",
+	"\tunsigned int cols = ((short int *)array_cols)[n];",
+	"\tunsigned int ui = i;",
+	"\tunsigned int uj = j;",
+	"",
+	"\tif (c && exp_error)",
+	"\t\treturn 0;",
+	"\tif (two) {",
+	"\t\tif (cols == 0 || ui >= siz/cols || uj >= cols)",
+	"\t\t\tgoto bounds;",
+	"\t\tui = ui*cols + uj;",
+	"\t}",
+	"\telse if (ui >= siz)",
+	"\t\tgoto bounds;",
+	"\treturn memory + ((short int *)array_table)[n] + ui*((short int *)array_esz)[n];",
+	"bounds:",
+	"\tprintmsg(boundsmsg);",
+	"\texp_error = 1;",
+	"\treturn 0;",
+	"}",
+	"",
+	"short int x_el(c, n, two, i, j)",
+	"int c;",
+	"int n;",
+	"int two;",
+	"short int i;",
+	"short int j;",
+	"{",
+	"\tuchar *p = x_ref(c, n, two, i, j);",
+	"",
+	"\tif (p == 0)",
+	"\t\treturn 0;",
+	"\tif (((short int *)array_esz)[n] == 1)",
+	"\t\treturn *p & 0xFF;",
+	"\treturn *(short int *)p;",
+	"}",
+	"",
+	"voidret x_put(p, n, v)",
+	"uchar *p;",
+	"int n;",
+	"short int v;",
+	"{",
+	"\tif (((short int *)array_esz)[n] == 1)",
+	"\t\t*p = v;",
+	"\telse",
+	"\t\t*(short int *)p = v;",
+	"}",
+	"",
+	"short int x_div(a, b)",
+	"short int a;",
+	"short int b;",
+	"{",
+	"\tif (b == 0) {",
+	"\t\texp_error = 1;",
+	"\t\treturn a;",
+	"\t}",
+	"\treturn a / b;",
+	"}",
+	"",
+	"short int x_mod(a, b)",
+	"short int a;",
+	"short int b;",
+	"{",
+	"\tif (b == 0) {",
+	"\t\texp_error = 1;",
+	"\t\treturn a;",
+	"\t}",
+	"\treturn a % b;",
+	"}",
+	"",
+	"short int x_shl(a, b)",
+	"short int a;",
+	"short int b;",
+	"{",
+	"\tif (b < 0 || b > 15)",
+	"\t\treturn 0;",
+	"\treturn (unsigned short)a << b;",
+	"}",
+	"",
+	"short int x_shr(a, b)",
+	"short int a;",
+	"short int b;",
+	"{",
+	"\tif (b < 0 || b > 15)",
+	"\t\treturn 0;",
+	"\treturn (unsigned short)a >> b;",
+	"}",
+	"",
+	"short int x_abs(a)",
+	"short int a;",
+	"{",
+	"\treturn a < 0 ? -a : a;",
+	"}",
+	"",
+	"short int x_sqr(a)",
+	"short int a;",
+	"{",
+	"\tif (a < 0) {",
+	"\t\texp_error = 1;",
+	"\t\treturn a;",
+	"\t}",
+	"\treturn isqrt(a);",
+	"}",
+	"",
+	"short int x_srch(name, n, v)",
+	"short int name;",
+	"short int n;",
+	"short int v;",
+	"{",
+	"\tif (exp_error)",
+	"\t\treturn 0;",
+	"\treturn search_run(name, n, v);",
+	"}",
+	"",
+	"/* MEMSUM() or CRC() */",
+	"short int x_mem(f, a, n)",
+	"int f;",
+	"short int a;",
+	"short int n;",
+	"{",
+	"\tif (exp_error)",
+	"\t\treturn 0;",
+	"\tif (!mem_range(a, n)) {",
+	"\t\tprintmsg(boundsmsg);",
+	"\t\texp_error = 1;",
+	"\t\treturn 0;",
+	"\t}",
+	"\tif (f == FUNC_MEMSUM)",
+	"\t\treturn mem_sum(a, n);",
+	"\treturn mem_crc(a, n);",
+	"}",
+	"",
+	"/* native function n of k arguments */",
+	"short int x_nat(n, k, a0, a1, a2, a3)",
+	"int n;",
+	"int k;",
+	"short int a0;",
+	"short int a1;",
+	"short int a2;",
+	"short int a3;",
+	"{",
+	"\tshort int args[4];",
+	"",
+	"\tif (k > 0 && exp_error)",
+	"\t\treturn 0;",
+	"\targs[0] = a0;",
+	"\targs[1] = a1;",
+	"\targs[2] = a2;",
+	"\targs[3] = a3;",
+	"\treturn native_call(n, args);",
+	"}",
+	"",
+	"/* a quoted string of the program text */",
+	"voidret x_str(at, n)",
+	"int at;",
+	"int n;",
+	"{",
+	"\twhile (n--)",
+	"\t\tputch(pgm_start[at++]);",
+	"}",
+	"",
+	"voidret x_for(var, terminal, step, ln, line)",
+	"int var;",
+	"short int terminal;",
+	"short int step;",
+	"int ln;",
+	"int line;",
+	"{",
+	"\tstruct stack_for_frame *f;",
+	"",
+	"\tsp -= sizeof(struct stack_for_frame);",
+	"\tf = (struct stack_for_frame *)sp;",
+	"\tf->frame_type = STACK_FOR_FLAG;",
+	"\tf->for_var = var;",
+	"\tf->terminal = terminal;",
+	"\tf->step = step;",
+	"\tf->sff_txtpos = (uchar *)(long)ln;",
+	"\tf->sff_current_line = pgm_start + line;",
+	"}",
+	"",
+	"voidret x_gosub(ln, line)",
+	"int ln;",
+	"int line;",
+	"{",
+	"\tstruct stack_gosub_frame *f;",
+	"",
+	"\tsp -= sizeof(struct stack_gosub_frame);",
+	"\tf = (struct stack_gosub_frame *)sp;",
+	"\tf->frame_type = STACK_GOSUB_FLAG;",
+	"\tf->sgf_txtpos = (uchar *)(long)ln;",
+	"\tf->sgf_current_line = pgm_start + line;",
+	"}",
+	"",
+	"#define FAIL(e, at) { rt_error(e, at); goto done; }",
+	0
+};
+
+char *fnames[] = {
+	"peek", "x_abs", 0, 0, "host_inp", 0, "rand", "chan_eof", 0, 0, 0, 0, "sin_deg"
+};
+
+voidret ind()
+{
+	short int i;
+
+	for (i=0; i<depth; i++)
+		putc('\t', out);
+}
+
+/* work out the flags of every node; a node always comes after the nodes
+ * it is made of
+ */
+voidret eflags()
+{
+	short int x;
+	struct cnode *n;
+	uchar f;
+
+	for (x=0; x<cmp_nodes; x++) {
+		n = cmp_node + x;
+		f = 0;
+		if (n->op != X_NUM && n->op != X_VAR && n->op != X_STR) {
+			if (n->a >= 0)
+				f |= eflag[n->a];
+			if (n->b >= 0)
+				f |= eflag[n->b];
+		}
+		switch (n->op) {
+			case X_ELEM:
+				f |= F_FAIL|F_EFFECT;
+				break;
+			case X_DIV:
+			case X_MOD:
+				if (cmp_node[n->b].op != X_NUM || cmp_node[n->b].val == 0)
+					f |= F_FAIL;
+				break;
+			case X_NATIVE:
+				f |= F_EFFECT;
+				break;
+			case X_FUNC:
+				switch (n->n) {
+					case FUNC_PEEK:
+						f |= F_MEM;
+						break;
+					case FUNC_INP:
+					case FUNC_RAND:
+					case FUNC_EOF:
+						f |= F_EFFECT;
+						break;
+					case FUNC_SQR:
+						f |= F_FAIL;
+						break;
+					case FUNC_SEARCH:
+						f |= F_FAIL|F_EFFECT;
+						break;
+					case FUNC_MEMSUM:
+					case FUNC_CRC:
+						f |= F_FAIL|F_EFFECT|F_MEM;
+						break;
+				}
+				break;
+		}
+		eflag[x] = f;
+		etemp[x] = -1;
+	}
+}
+
+voidret ev();
+
+/* argument i of a function node, or -1 */
+short int arg(x, i)
+short int x;
+int i;
+{
+	short int l = cmp_node[x].a;
+
+	while (l >= 0 && i-- > 0)
+		l = cmp_node[l].b;
+	return l < 0 ? -1 : cmp_node[l].a;
+}
+
+voidret num(v)
+short int v;
+{
+	if (v == -32768)
+		fprintf(out, "(-32767-1)");
+	else if (v < 0)
+		fprintf(out, "(%d)", v);
+	else
+		fprintf(out, "%d", v);
+}
+
+/* the C for node x, given that its parts have been worked out */
+voidret form(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+	short int b;
+
+	switch (n->op) {
+		case X_NUM:
+			num(n->val);
+			break;
+		case X_VAR:
+			putc('A' + n->n, out);
+			break;
+		case X_NOT:
+			fprintf(out, "(~");
+			ev(n->a);
+			fprintf(out, ")");
+			break;
+		case X_ADD:
+		case X_SUB:
+		case X_MUL:
+			fprintf(out, "(short int)(");
+			ev(n->a);
+			fprintf(out, n->op == X_ADD ? " + " : n->op == X_SUB ? " - " : " * ");
+			ev(n->b);
+			fprintf(out, ")");
+			break;
+		case X_DIV:
+		case X_MOD:
+			if (eflag[x] & F_FAIL && !(eflag[n->a] & F_FAIL) || cmp_node[n->b].op != X_NUM) {
+				fprintf(out, n->op == X_DIV ? "x_div(" : "x_mod(");
+				ev(n->a);
+				fprintf(out, ", ");
+			}
+			else {
+				fprintf(out, "(short int)(");
+				ev(n->a);
+				fprintf(out, n->op == X_DIV ? " / " : " %% ");
+			}
+			ev(n->b);
+			fprintf(out, ")");
+			break;
+		case X_SHL:
+		case X_SHR:
+			b = n->b;
+			if (cmp_node[b].op != X_NUM) {
+				fprintf(out, n->op == X_SHL ? "x_shl(" : "x_shr(");
+				ev(n->a);
+				fprintf(out, ", ");
+				ev(b);
+				fprintf(out, ")");
+			}
+			else if (cmp_node[b].val < 0 || cmp_node[b].val > 15)
+				fprintf(out, "0");
+			else {
+				fprintf(out, "(short int)((unsigned short)");
+				ev(n->a);
+				fprintf(out, n->op == X_SHL ? " << %d)" : " >> %d)", cmp_node[b].val);
+			}
+			break;
+		case X_GE:
+		case X_NE:
+		case X_GT:
+		case X_EQ:
+		case X_LE:
+		case X_LT:
+		case X_AND:
+		case X_OR:
+		case X_XOR:
+			fprintf(out, "(");
+			ev(n->a);
+			switch (n->op) {
+				case X_GE: fprintf(out, " >= "); break;
+				case X_NE: fprintf(out, " != "); break;
+				case X_GT: fprintf(out, " > "); break;
+				case X_EQ: fprintf(out, " == "); break;
+				case X_LE: fprintf(out, " <= "); break;
+				case X_LT: fprintf(out, " < "); break;
+				case X_AND: fprintf(out, " & "); break;
+				case X_OR: fprintf(out, " | "); break;
+				case X_XOR: fprintf(out, " ^ "); break;
+			}
+			ev(n->b);
+			fprintf(out, ")");
+			break;
+		case X_FUNC:
+			switch (n->n) {
+				case FUNC_FRE:
+					fprintf(out, "(short int)(sp - image_end)");
+					break;
+				case FUNC_COS:
+					fprintf(out, "sin_deg(");
+					ev(arg(x, 0));
+					fprintf(out, " %% 360 + 90)");
+					break;
+				case FUNC_ATN:
+					fprintf(out, "atn_deg(");
+					ev(arg(x, 0));
+					fprintf(out, ", ");
+					if (arg(x, 1) >= 0)
+						ev(arg(x, 1));
+					else
+						fprintf(out, "16384");
+					fprintf(out, ")");
+					break;
+				case FUNC_SQR:
+					fprintf(out, "x_sqr(");
+					ev(arg(x, 0));
+					fprintf(out, ")");
+					break;
+				default:
+					fprintf(out, "%s(", fnames[n->n]);
+					ev(arg(x, 0));
+					fprintf(out, ")");
+					break;
+			}
+			break;
+	}
+}
+
+/* the value of node x: a temporary if it has one, or the C for it */
+voidret ev(x)
+short int x;
+{
+	if (etemp[x] >= 0)
+		fprintf(out, "t%d", etemp[x]);
+	else
+		form(x);
+}
+
+short int newtemp(x)
+short int x;
+{
+	etemp[x] = ntemps++;
+	if (ntemps > maxtemps)
+		maxtemps = ntemps;
+	return etemp[x];
+}
+
+voidret pre();
+
+/* work out node x unless an earlier error means the interpreter would
+ * not get that far; it only matters if x does something
+ */
+voidret guard(x)
+short int x;
+{
+	if (maybe_err && eflag[x] & F_EFFECT) {
+		ind();
+		fprintf(out, "if (!exp_error) {\n");
+		depth++;
+		pre(x);
+		depth--;
+		ind();
+		fprintf(out, "} else\n");
+		ind();
+		fprintf(out, "\tt%d = 0;\n", etemp[x]);
+	}
+	else
+		pre(x);
+}
+
+/* Work out node x and the nodes it is made of that can fail or do
+ * something, into temporaries, in the order the interpreter evaluates
+ * them. Anything else is left to ev().
+ */
+voidret pre(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+	short int t;
+	short int a;
+	int i;
+
+	if (!(eflag[x] & CAREFUL))
+		return 0;
+	switch (n->op) {
+		case X_SHL:
+		case X_SHR:
+		case X_GE:
+		case X_NE:
+		case X_GT:
+		case X_EQ:
+		case X_LE:
+		case X_LT:
+		case X_AND:
+		case X_OR:
+		case X_XOR:
+			/* these stop at an error in their left operand */
+			pre(n->a);
+			t = newtemp(x);
+			if (maybe_err && eflag[n->b] & F_EFFECT) {
+				ind();
+				fprintf(out, "if (!exp_error) {\n");
+				depth++;
+				pre(n->b);
+				ind();
+				fprintf(out, "t%d = ", t);
+				form(x);
+				fprintf(out, ";\n");
+				depth--;
+				ind();
+				fprintf(out, "} else\n");
+				ind();
+				fprintf(out, "\tt%d = ", t);
+				ev(n->a);
+				fprintf(out, ";\n");
+				return 0;
+			}
+			pre(n->b);
+			break;
+		case X_ELEM:
+			pre(n->a);
+			if (n->b >= 0)
+				guard(n->b);
+			t = newtemp(x);
+			ind();
+			fprintf(out, "t%d = x_el(%d, %d, %d, ", t, maybe_err, n->n, n->b >= 0);
+			ev(n->a);
+			fprintf(out, ", ");
+			if (n->b >= 0)
+				ev(n->b);
+			else
+				fprintf(out, "0");
+			fprintf(out, ");\n");
+			maybe_err = 1;
+			return 0;
+		case X_NATIVE:
+			for (i=0; (a = arg(x, i)) >= 0; i++)
+				if (i == 0)
+					pre(a);
+				else
+					guard(a);
+			t = newtemp(x);
+			ind();
+			fprintf(out, "t%d = x_nat(%d, %d", t, n->n, i);
+			for (i=0; i<4; i++) {
+				fprintf(out, ", ");
+				if ((a = arg(x, i)) >= 0)
+					ev(a);
+				else
+					fprintf(out, "0");
+			}
+			fprintf(out, ");\n");
+			return 0;
+		case X_FUNC:
+			if (n->n == FUNC_SEARCH || n->n == FUNC_MEMSUM || n->n == FUNC_CRC) {
+				/* these give up at the first bad argument */
+				a = n->n == FUNC_SEARCH;
+				pre(arg(x, a));
+				guard(arg(x, a+1));
+				t = newtemp(x);
+				ind();
+				if (n->n == FUNC_SEARCH)
+					fprintf(out, "t%d = x_srch(%d, ", t, cmp_node[arg(x, 0)].val);
+				else
+					fprintf(out, "t%d = x_mem(%d, ", t, n->n);
+				ev(arg(x, a));
+				fprintf(out, ", ");
+				ev(arg(x, a+1));
+				fprintf(out, ");\n");
+				maybe_err = 1;
+				return 0;
+			}
+			for (i=0; (a = arg(x, i)) >= 0; i++)
+				pre(a);
+			break;
+		default:
+			if (n->a >= 0)
+				pre(n->a);
+			if (n->b >= 0)
+				pre(n->b);
+			break;
+	}
+	if (etemp[x] < 0)
+		t = newtemp(x);
+	ind();
+	fprintf(out, "t%d = ", etemp[x]);
+	form(x);
+	fprintf(out, ";\n");
+	if (n->op == X_DIV || n->op == X_MOD || n->op == X_FUNC && n->n == FUNC_SQR)
+		maybe_err |= eflag[x] & F_FAIL;
+}
+
+/* an Invalid expression if exp_error may have been set */
+voidret check()
+{
+	if (maybe_err) {
+		ind();
+		fprintf(out, "if (exp_error) FAIL(RT_INVALID, 0);\n");
+		maybe_err = 0;
+	}
+}
+
+/* work out expression x for a statement */
+voidret expr(x)
+short int x;
+{
+	pre(x);
+	check();
+}
+
+/* find the variable or element x a value is going to, as getvar() */
+voidret ref(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+
+	if (n->op != X_ELEM)
+		return 0;
+	pre(n->a);
+	if (n->b >= 0)
+		guard(n->b);
+	ind();
+	fprintf(out, "p = x_ref(%d, %d, %d, ", maybe_err, n->n, n->b >= 0);
+	ev(n->a);
+	fprintf(out, ", ");
+	if (n->b >= 0)
+		ev(n->b);
+	else
+		fprintf(out, "0");
+	fprintf(out, ");\n");
+	ind();
+	fprintf(out, "if (p == 0) FAIL(RT_INVALID, 0);\n");
+	maybe_err = 0;
+}
+
+/* store to x, found by ref(), the value printed between the two */
+voidret store(x)
+short int x;
+{
+	ind();
+	if (cmp_node[x].op == X_VAR)
+		fprintf(out, "%c = ", 'A' + cmp_node[x].n);
+	else
+		fprintf(out, "x_put(p, %d, ", cmp_node[x].n);
+}
+
+voidret stored(x)
+short int x;
+{
+	fprintf(out, cmp_node[x].op == X_VAR ? ";\n" : ");\n");
+}
+
+/* a file channel, #n, into k as getchan(); a bad one fails as fail does */
+voidret chan(cell, fail)
+short int cell;
+char *fail;
+{
+	short int e = cmp_node[cell].a;
+
+	pre(e);
+	ind();
+	fprintf(out, "k = ");
+	ev(e);
+	fprintf(out, ";\n");
+	ind();
+	fprintf(out, "if (exp_error || k < 1 || k > NCHAN) FAIL(%s, %d);\n", fail,
+		cmp_node[cell].val);
+	maybe_err = 0;
+}
+
+voidret select(on)
+uchar on;
+{
+	if (on) {
+		ind();
+		fprintf(out, "select_output(k);\n");
+	}
+}
+
+voidret unselect(on)
+uchar on;
+{
+	if (on) {
+		ind();
+		fprintf(out, "select_output(0);\n");
+	}
+}
+
+/* the channel and items of a PRINT */
+voidret print(st)
+struct cstmt *st;
+{
+	short int l;
+	short int e;
+	uchar f = st->a >= 0;
+
+	if (f) {
+		chan(st->a, "RT_IO");
+		ind();
+		fprintf(out, "if (!select_output(k)) FAIL(RT_IO, 0);\n");
+		unselect(f);
+	}
+	for (l=st->b; l >= 0; l = cmp_node[l].b) {
+		e = cmp_node[l].a;
+		if (cmp_node[e].op == X_STR) {
+			select(f);
+			ind();
+			fprintf(out, "x_str(%d, %d);\n", cmp_node[e].val, cmp_node[e].a);
+		}
+		else {
+			expr(e);
+			select(f);
+			ind();
+			fprintf(out, "printnum(");
+			ev(e);
+			fprintf(out, ");\n");
+		}
+		unselect(f);
+	}
+}
+
+/* flags of all the expressions of a statement */
+uchar sflags(st)
+struct cstmt *st;
+{
+	uchar f = 0;
+
+	if (st->op == S_MAT || st->op == S_OPEN)
+		return st->op == S_MAT && st->c >= 0 ? eflag[st->c] : 0;
+	if (st->a >= 0)
+		f |= eflag[st->a];
+	if (st->b >= 0)
+		f |= eflag[st->b];
+	if (st->c >= 0 && st->op != S_DIM)
+		f |= eflag[st->c];
+	return f;
+}
+
+/* the line a statement with index s is on, or nlines for the end */
+short int lineof(s)
+short int s;
+{
+	return eline[s];
+}
+
+/* the console INPUT statement s, as input: in loop() */
+voidret input(s)
+short int s;
+{
+	struct cstmt *st = cmp_stmt + s;
+	short int l;
+	int i, nvars;
+
+	for (nvars=0, l=st->b; l >= 0; l = cmp_node[l].b)
+		nvars++;
+	ind();
+	fprintf(out, "k = 0;\n");
+	fprintf(out, "Q%d:\n", s);
+	ind();
+	fprintf(out, "if ((inp = rt_getln()) == 0) goto done;\n");
+	if (nvars > 1) {
+		ind();
+		fprintf(out, "switch (k) {\n");
+		for (i=1; i<nvars; i++) {
+			ind();
+			fprintf(out, "case %d: goto Q%d_%d;\n", i, s, i);
+		}
+		ind();
+		fprintf(out, "}\n");
+	}
+	for (i=0, l=st->b; l >= 0; i++, l = cmp_node[l].b) {
+		if (i > 0)
+			fprintf(out, "Q%d_%d:\n", s, i);
+		ref(cmp_node[l].a);
+		ind();
+		fprintf(out, "if ((inp = getnum(inp, &v)) == 0) goto B%d;\n", s);
+		store(cmp_node[l].a);
+		fprintf(out, "v");
+		stored(cmp_node[l].a);
+		ind();
+		if (cmp_node[l].b >= 0)
+			fprintf(out, "if (*inp == ',') inp++; else if (*inp == NL) { k = %d; goto Q%d; } else goto B%d;\n",
+				i+1, s, s);
+		else
+			fprintf(out, "if (*inp != NL) goto B%d;\n", s);
+	}
+	ind();
+	fprintf(out, "goto N%d;\n", s);
+	fprintf(out, "B%d:\n", s);
+	ind();
+	fprintf(out, "printmsg(badinputmsg);\n");
+	ind();
+	fprintf(out, "goto Q%d;\n", s);
+	fprintf(out, "N%d:\n", s);
+}
+
+/* emit statement s; returns 0 if it can't be translated */
+uchar stmt(s)
+short int s;
+{
+	struct cstmt *st = cmp_stmt + s;
+	short int l;
+	short int f;
+	uchar fl = sflags(st);
+	uchar *p;
+
+	ntemps = 0;
+	maybe_err = 0;
+	if (fl & F_MEM || st->op == S_POKE || st->op == S_MEMCPY || st->op == S_MEMSET) {
+		ind();
+		fprintf(out, "SAVEV;\n");
+	}
+
+	switch (st->op) {
+		case S_TEXT:
+			if (st->n == CE_DIRECT)
+				return 0;
+			if (st->a >= 0 || st->b >= 0)
+				print(st);
+			ind();
+			fprintf(out, "FAIL(%s, %u);\n", st->n == CE_SYNTAX ? "RT_SYNTAX" :
+				st->n == CE_IO ? "RT_IO" : "RT_INVALID", st->end);
+			break;
+		case S_LET:
+			ref(st->a);
+			expr(st->b);
+			store(st->a);
+			ev(st->b);
+			stored(st->a);
+			break;
+		case S_PRINT:
+			print(st);
+			if (!st->n) {
+				f = st->a >= 0;
+				select(f);
+				ind();
+				fprintf(out, "put_nl();\n");
+				unselect(f);
+			}
+			break;
+		case S_IF:
+			expr(st->a);
+			ind();
+			fprintf(out, "if (!");
+			ev(st->a);
+			fprintf(out, ") goto L%d;\n", lineof(st->next_line));
+			break;
+		case S_GOSUB:
+		case S_GOTO:
+			if (st->target < 0)
+				expr(st->a);
+			if (st->op == S_GOSUB) {
+				ind();
+				fprintf(out, "x_gosub(%d, %u);\n", lineof(st->next_line), st->line);
+			}
+			ind();
+			if (st->target >= 0)
+				fprintf(out, "goto L%d;\n", lineof(st->target));
+			else {
+				fprintf(out, "ln = rt_line(");
+				ev(st->a);
+				fprintf(out, ", pgm_lines, NLINES);\n");
+				ind();
+				fprintf(out, "goto jump;\n");
+			}
+			break;
+		case S_RETURN:
+			ind();
+			fprintf(out, "f = find_frame(0);\n");
+			ind();
+			fprintf(out, "if (f == 0) FAIL(RT_SYNTAX, %u);\n", st->end);
+			ind();
+			fprintf(out, "if (*f != STACK_GOSUB_FLAG) FAIL(RT_STUFFED, 0);\n");
+			ind();
+			fprintf(out, "ln = (int)(long)((struct stack_gosub_frame *)f)->sgf_txtpos;\n");
+			ind();
+			fprintf(out, "sp += sizeof(struct stack_gosub_frame);\n");
+			ind();
+			fprintf(out, "goto jump;\n");
+			break;
+		case S_PARFOR:
+			/* run as a FOR, but with the checks the interpreter makes */
+			f = ir_pfcheck(s, &l);
+			if (f == PF_SHARED || f == PF_BODY) {
+				ind();
+				fprintf(out, "FAIL(%s, 0);\n", f == PF_SHARED ? "RT_SHARED" : "RT_PARBODY");
+				break;
+			}
+			/* fallthrough */
+		case S_FOR:
+			expr(st->a);
+			expr(st->b);
+			if (st->c >= 0)
+				expr(st->c);
+			ind();
+			fprintf(out, "x_for('%c', ", 'A' + st->n);
+			ev(st->b);
+			fprintf(out, ", ");
+			if (st->c >= 0)
+				ev(st->c);
+			else
+				fprintf(out, "1");
+			fprintf(out, ", %d, %u);\n", lineof(st->next_line), st->line);
+			ind();
+			fprintf(out, "%c = ", 'A' + st->n);
+			ev(st->a);
+			fprintf(out, ";\n");
+			break;
+		case S_NEXT:
+			if (st->n < 'A' || st->n > 'Z') {
+				ind();
+				fprintf(out, "f = find_frame(%d);\n", st->n);
+				ind();
+				fprintf(out, "FAIL(f ? RT_STUFFED : RT_SYNTAX, %u);\n", st->end);
+				break;
+			}
+			ind();
+			fprintf(out, "f = sp[0] == STACK_FOR_FLAG && sp[1] == '%c' ? sp : find_frame('%c');\n",
+				st->n, st->n);
+			ind();
+			fprintf(out, "if (f == 0) FAIL(RT_SYNTAX, %u);\n", st->end);
+			ind();
+			fprintf(out, "if (*f != STACK_FOR_FLAG) FAIL(RT_STUFFED, 0);\n");
+			ind();
+			fprintf(out, "fr = (struct stack_for_frame *)f;\n");
+			ind();
+			fprintf(out, "%c = %c + fr->step;\n", st->n, st->n);
+			ind();
+			fprintf(out, "if ((fr->step > 0 && %c <= fr->terminal) || (fr->step < 0 && %c >= fr->terminal)) {\n",
+				st->n, st->n);
+			ind();
+			fprintf(out, "\tsp = f;\n");
+			ind();
+			fprintf(out, "\tln = (int)(long)fr->sff_txtpos;\n");
+			/* most likely it goes back to the nearest FOR of the variable */
+			for (l=s-1; l >= 0; l--)
+				if ((cmp_stmt[l].op == S_FOR || cmp_stmt[l].op == S_PARFOR)
+						&& 'A' + cmp_stmt[l].n == st->n)
+					break;
+			if (l >= 0) {
+				ind();
+				fprintf(out, "\tif (ln == %d) goto L%d;\n", lineof(cmp_stmt[l].next_line),
+					lineof(cmp_stmt[l].next_line));
+			}
+			ind();
+			fprintf(out, "\tgoto jump;\n");
+			ind();
+			fprintf(out, "}\n");
+			ind();
+			fprintf(out, "sp = f + sizeof(struct stack_for_frame);\n");
+			break;
+		case S_END:
+		case S_BYE:
+			ind();
+			fprintf(out, "goto done;\n");
+			break;
+		case S_STOP:
+			ind();
+			fprintf(out, "printmsg(breakmsg);\n");
+			ind();
+			fprintf(out, "goto done;\n");
+			break;
+		case S_REM:
+			break;
+		case S_READ:
+			for (l=st->b; l >= 0; l = cmp_node[l].b) {
+				ref(cmp_node[l].a);
+				ind();
+				fprintf(out, "if (data_ptr >= data_count) FAIL(RT_NODATA, 0);\n");
+				store(cmp_node[l].a);
+				fprintf(out, "data_pool[data_ptr++]");
+				stored(cmp_node[l].a);
+			}
+			break;
+		case S_RESTORE:
+			if (st->a < 0) {
+				ind();
+				fprintf(out, "data_ptr = 0;\n");
+				break;
+			}
+			expr(st->a);
+			ind();
+			fprintf(out, "data_ptr = data_find(");
+			ev(st->a);
+			fprintf(out, ");\n");
+			break;
+		case S_INPUT:
+			if (st->a < 0) {
+				input(s);
+				break;
+			}
+			chan(st->a, "RT_SYNTAX");
+			ind();
+			fprintf(out, "inp = 0;\n");
+			for (l=st->b; l >= 0; l = cmp_node[l].b) {
+				ref(cmp_node[l].a);
+				ind();
+				fprintf(out, "if ((inp == 0 || *inp == NL) && (inp = rt_getfile(k)) == 0) FAIL(RT_EOF, 0);\n");
+				ind();
+				fprintf(out, "inp = getnum(inp, &v);\n");
+				ind();
+				fprintf(out, "if (inp == 0 || (*inp != ',' && *inp != NL)) { printmsg(badinputmsg); goto done; }\n");
+				ind();
+				fprintf(out, "if (*inp == ',') inp++;\n");
+				store(cmp_node[l].a);
+				fprintf(out, "v");
+				stored(cmp_node[l].a);
+			}
+			break;
+		case S_DIM:
+			pre(st->a);
+			if (st->b >= 0)
+				pre(st->b);
+			check();
+			ind();
+			fprintf(out, "if (!dim_run(%d, ", st->n);
+			ev(st->a);
+			fprintf(out, ", ");
+			if (st->b >= 0) {
+				ev(st->b);
+				fprintf(out, " + 1");
+			}
+			else
+				fprintf(out, "0");
+			fprintf(out, ", %d)) FAIL(RT_NOMEM, 0);\n", st->c);
+			break;
+		case S_POKE:
+		case S_OUT:
+			expr(st->a);
+			expr(st->b);
+			ind();
+			fprintf(out, st->op == S_POKE ? "poke(" : "outp(");
+			ev(st->a);
+			fprintf(out, ", ");
+			ev(st->b);
+			fprintf(out, ");\n");
+			break;
+		case S_SLEEP:
+			expr(st->a);
+			break;
+		case S_CLEAR:
+			ind();
+			fprintf(out, "clear();\n");
+			break;
+		case S_OPEN:
+			chan(st->a, "RT_SYNTAX");
+			ind();
+			fprintf(out, "if (!chan_open(k, \"");
+			p = pgm_start + cmp_node[st->b].val;
+			for (l=0; l<cmp_node[st->b].a; l++) {
+				if (p[l] == '"' || p[l] == '\\')
+					putc('\\', out);
+				putc(p[l], out);
+			}
+			fprintf(out, "\", '%c')) FAIL(RT_IO, 0);\n",
+				st->n == 0 ? 'r' : st->n == 1 ? 'w' : 'a');
+			break;
+		case S_CLOSE:
+			if (st->a < 0) {
+				ind();
+				fprintf(out, "chan_close(0);\n");
+				break;
+			}
+			for (l=st->a; l >= 0; l = cmp_node[l].b) {
+				chan(l, "RT_SYNTAX");
+				ind();
+				fprintf(out, "chan_close(k);\n");
+			}
+			break;
+		case S_MAT:
+			if (st->d == 'f')
+				expr(st->c);
+			ind();
+			fprintf(out, "if (!mat_fits(%d, %d, %d)) FAIL(RT_BOUNDS, 0);\n", st->n, st->a, st->b);
+			if (st->d == 's')
+				expr(st->c);
+			ind();
+			fprintf(out, "mat_run('%c', %d, %d, %d, ", st->d, st->n, st->a, st->b);
+			if (st->c >= 0)
+				ev(st->c);
+			else
+				fprintf(out, "0");
+			fprintf(out, ");\n");
+			break;
+		case S_SORT:
+			expr(st->a);
+			ind();
+			fprintf(out, "if (!sort_run(%d, ", st->n);
+			ev(st->a);
+			fprintf(out, ", %d)) FAIL(RT_BOUNDS, 0);\n", st->d == 1);
+			break;
+		case S_MEMCPY:
+		case S_MEMSET:
+			expr(st->a);
+			expr(st->b);
+			expr(st->c);
+			ind();
+			fprintf(out, st->op == S_MEMCPY ? "k = mem_copy(" : "k = mem_set(");
+			ev(st->a);
+			fprintf(out, ", ");
+			ev(st->b);
+			fprintf(out, ", ");
+			ev(st->c);
+			fprintf(out, ");\n");
+			break;
+		case S_RANDOMIZE:
+			if (st->a < 0) {
+				ind();
+				fprintf(out, "randomize(host_seed());\n");
+				break;
+			}
+			expr(st->a);
+			ind();
+			fprintf(out, "randomize(");
+			ev(st->a);
+			fprintf(out, ");\n");
+			break;
+		case S_RANDFILL:
+			expr(st->a);
+			expr(st->b);
+			ind();
+			fprintf(out, "if (!randfill_run(%d, ", st->n);
+			ev(st->a);
+			fprintf(out, ", ");
+			ev(st->b);
+			fprintf(out, ")) FAIL(RT_BOUNDS, 0);\n");
+			break;
+	}
+
+	if (st->op == S_POKE || st->op == S_MEMCPY || st->op == S_MEMSET || st->op == S_CLEAR) {
+		ind();
+		fprintf(out, "LOADV;\n");
+	}
+	if (st->op == S_MEMCPY || st->op == S_MEMSET) {
+		ind();
+		fprintf(out, "if (!k) FAIL(RT_BOUNDS, 0);\n");
+	}
+	return 1;
+}
+
+/* the number of the line at line */
+unsigned int lnum(line)
+uchar *line;
+{
+	return ((line[0] & 0xFF) << 8) + (line[1] & 0xFF);
+}
+
+/* the line at line as a comment */
+voidret comment(line)
+uchar *line;
+{
+	uchar *s = line+3;   /* past the line number and length */
+
+	fprintf(out, "\t/* %u ", lnum(line));
+	while (*s != NL) {
+		if (s[0] == '*' && s[1] == '/')
+			fprintf(out, "* ");
+		else
+			putc(*s, out);
+		s++;
+	}
+	fprintf(out, " */\n");
+}
+
+/* write the translation of the loaded program, named name, to stdout.
+ * Returns 0, or 1 if it can't be translated.
+ */
+int emit_c(name)
+char *name;
+{
+	FILE *body;
+	short int s;
+	short int i;
+	int c;
+	uchar *line;
+
+	if (compile() < 0) {
+		fprintf(stderr, "%s: program too big to translate\n", name);
+		return 1;
+	}
+	eflags();
+
+	/* number the lines */
+	nlines = 0;
+	for (s=0; s<cmp_stmts; s++) {
+		if (s == 0 || cmp_stmt[s].line != cmp_stmt[s-1].line)
+			nlines++;
+		eline[s] = nlines-1;
+	}
+	eline[cmp_stmts] = nlines;
+
+	/* main() goes to a scratch file first, to find out how many
+	 * temporaries it needs
+	 */
+	body = tmpfile();
+	if (body == NULL) {
+		fprintf(stderr, "%s: can't make a scratch file\n", name);
+		return 1;
+	}
+	out = body;
+	maxtemps = 0;
+	depth = 1;
+	for (s=0; s<cmp_stmts; s++) {
+		if (s == 0 || eline[s] != eline[s-1]) {
+			fprintf(out, "L%d:\n", eline[s]);
+			comment(pgm_start + cmp_stmt[s].line);
+		}
+		if (!stmt(s)) {
+			line = pgm_start + cmp_stmt[s].line;
+			fprintf(stderr, "%s: line %u: LIST, LOAD, NEW, RUN, SAVE and STATS can't be translated\n",
+				name, lnum(line));
+			fclose(body);
+			return 1;
+		}
+	}
+
+	out = stdout;
+	fprintf(out, "/* %s, translated by tbasic --emit-c */\n\n", name);
+	fprintf(out, "#include <stdio.h>\n#include \"host.h\"\n#include \"tbasic.h\"\n\n");
+
+	fprintf(out, "/* the program text, which goes into memory[] */\nuchar pgm_text[] = {");
+	for (i=0; i<pgm_end-pgm_start; i++)
+		fprintf(out, "%s%d,", i % 16 ? " " : "\n\t", pgm_start[i]);
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "#define NLINES %d\nunsigned short pgm_lines[] = {", nlines);
+	for (s=0; s<cmp_stmts; s++)
+		if (s == 0 || eline[s] != eline[s-1]) {
+			line = pgm_start + cmp_stmt[s].line;
+			fprintf(out, "%s%u,", eline[s] % 10 ? " " : "\n\t",
+				lnum(line));
+		}
+	fprintf(out, "\n\t0\n};\n\n");
+
+	for (i=0; prelude[i]; i++)
+		fprintf(out, "%s\n", prelude[i]);
+	fprintf(out, "\n/* the variables are locals; these copy them to and from memory[] */\n");
+	fprintf(out, "#define SAVEV {");
+	for (i=0; i<26; i++)
+		fprintf(out, "%s((short int *)variables_table)[%d] = %c;", i % 3 ? " " : " \\\n\t", i, 'A'+i);
+	fprintf(out, " }\n#define LOADV {");
+	for (i=0; i<26; i++)
+		fprintf(out, "%s%c = ((short int *)variables_table)[%d];", i % 3 ? " " : " \\\n\t", 'A'+i, i);
+	fprintf(out, " }\n\n");
+
+	fprintf(out, "int main(argc, argv)\nint argc;\nchar **argv;\n{\n");
+	fprintf(out, "\tshort int A, B, C, D, E, F, G, H, I, J, K, L, M,\n");
+	fprintf(out, "\t\tN, O, P, Q, R, S, T, U, V, W, X, Y, Z;\n");
+	for (i=0; i<maxtemps; i++)
+		fprintf(out, "%s t%d", i == 0 ? "\tshort int" : i % 10 ? "," : ",\n\t\t", i);
+	if (maxtemps)
+		fprintf(out, ";\n");
+	fprintf(out, "\tshort int v;\n\tint k;\n\tint ln;\n\tuchar *p;\n\tuchar *f;\n");
+	fprintf(out, "\tuchar *inp;\n\tstruct stack_for_frame *fr;\n\n");
+	fprintf(out, "\tif (!rt_start(argc, argv, pgm_text, sizeof(pgm_text)))\n");
+	fprintf(out, "\t\treturn rt_end();\n");
+	fprintf(out, "\tLOADV;\n");
+
+	rewind(body);
+	while ((c = getc(body)) != EOF)
+		putc(c, out);
+	fclose(body);
+
+	fprintf(out, "L%d:\ndone:\n\treturn rt_end();\n", nlines);
+	fprintf(out, "jump:\n\tswitch (ln) {\n");
+	for (i=0; i<nlines; i++)
+		fprintf(out, "\tcase %d: goto L%d;\n", i, i);
+	fprintf(out, "\t}\n\tgoto done;\n}\n");
+	fflush(out);
+	return 0;
+}
@@ -1,171 +1,1148 @@
-/* host.c
- *
- * This file holds host-specific code, for character IO, file IO, etc.
- */
-
-#ifdef DONOTUSE
-#include <sys/ioctl.h>
-#include <termios.h>
-#endif
-
-#include <stdio.h>
-#include "host.h"
-
-uchar memory[MEMSIZE];
-FILE *r_file = NULL;
-FILE *w_file = NULL;
-
-#ifdef LINUX
-voidret outp(x,y)
-unsigned short x;
-char y;
-{
-  printf("<OUTP %02X, %02X>", x, y);
-}
-
-uchar inp(x)
-unsigned short x;
-{
-  printf("<INP %02X -> 0x33>", x);
-  return 0x33;
-}
-#endif
-
-/* return 1 if raw_mode successfully enabled */
-voidret enable_raw_mode()
-{
-#ifdef DONOTUSE
-    /* there's really no reason for raw mode; everything seems to
-     *  work fine in cooked mode. So just avoid the nuisance...
-     */
-    struct termios term;
-    tcgetattr(0, &term);
-    term.c_lflag &= ~(ICANON | ECHO); // Disable echo as well
-    tcsetattr(0, TCSANOW, &term);
-    return 1;
-#endif
-  return 0; /* raw_mode unsupported */
-}
-
-voidret disable_raw_mode()
-{
-#ifdef DONOTUSE
-    struct termios term;
-    tcgetattr(0, &term);
-    term.c_lflag |= ICANON | ECHO;
-    tcsetattr(0, TCSANOW, &term);
-#endif
-}
-
-int kbhit() {
-#ifdef DONOTUSE
-    int byteswaiting;
-    ioctl(0, FIONREAD, &byteswaiting);
-    return byteswaiting > 0;
-#else
-  return 0;
-#endif
-}
-
-/* after a successful open_write, all putch() will go
- * to the file
- */
-int open_write(fn)
-char *fn;
-{
-  w_file = fopen(fn, "wt");
-  if (w_file == NULL) {
-    return 0;
-  } else {
-    return 1;
-  }
-}
-
-/* after a successful open_read, all getch() will come
- * from the file
- */
-int open_read(fn)
-char *fn;
-{
-  r_file = fopen(fn, "rt");
-  if (r_file == NULL) {
-    return 0;
-  } else {
-    return 1;
-  }
-}
-
-voidret close_file()
-{
-  if (w_file != NULL) {
-    fclose(w_file);
-    w_file = NULL;
-  }
-  if (r_file != NULL) {
-    fclose(r_file);
-    r_file = NULL;
-  }
-}
-
-char getch()
-{
-  if (r_file != NULL) {
-    if (feof(r_file)) {
-      return EOFC;
-    } else {
-      return fgetc(r_file);
-    }
-  } else {
-    return getchar();
-  }
-}
-
-voidret putch(c)
-uchar c;
-{
-  if (w_file) {
-    fputc(c, w_file);
-  } else {
-    putchar(c);
-  }
-}
-
-voidret put_nl()
-{
-#ifndef LINUX
-  putch(CR);
-#endif	
-  putch(NL);
-}
-
-voidret poke(x,y)
-unsigned short x;
-uchar y;
-{
-  memory[x] = y;
-}
-
-uchar peek(x)
-unsigned short x;
-{
-  return memory[x];
-}
-
-long seed = 1;
-
-/* random nunmber - may be machine dependent */
-unsigned short rand(amount)
-unsigned short amount;
-{
-    long int a = 16807L, m = 2147483647L, q = 127773L, r = 2836L;
-    long int lo, hi, test;
-
-    hi = seed / q;
-    lo = seed % q;
-    test = a * lo - r * hi;
-    if (test > 0) 
-		    seed = test; /* test for overflow */
-    else 
-		    seed = test + m;
-    return(seed % amount);
-}
+/* host.c
+ *
+ * This file holds host-specific code, for character IO, file IO, etc.
+ */
+
+#ifdef DONOTUSE
+#include <sys/ioctl.h>
+#include <termios.h>
+#endif
+
+#include <stdio.h>
+#ifdef LINUX
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+#if defined(LINUX) && defined(__GNUC__)
+/* eight 16-bit words; on x86-64 gcc maps these onto SSE2 registers */
+typedef short int v8hi __attribute__((vector_size(16), aligned(2)));
+#define MAT_SIMD
+#endif
+#include "host.h"
+
+uchar memory[MEMSIZE];
+FILE *r_file = NULL;
+FILE *w_file = NULL;
+
+#ifdef LINUX
+/* Asynchronous console output. putch() appends to a single-producer
+ * single-consumer ring and a writer thread drains it to fd 1 with large
+ * write() calls, so a slow terminal or pipe doesn't stall the interpreter.
+ * ring_head is only written by the interpreter and ring_tail only by the
+ * writer; each side publishes its index with a release store.
+ *
+ * Backpressure: when the ring is full putch() waits for the writer to make
+ * room, spinning briefly and then sleeping, so memory stays bounded and no
+ * output is ever dropped.
+ *
+ * When the ring stays empty the writer blocks on ring_cond, saying so in
+ * ring_asleep, and putch() wakes it. The writer sets ring_asleep before
+ * it looks at ring_head for the last time and putch() publishes ring_head
+ * before it looks at ring_asleep, both sequentially consistent, so one of
+ * them always sees the other.
+ */
+#define RING_SIZE 65536  /* must be a power of two */
+#define RING_MASK (RING_SIZE-1)
+#define RING_SPINS 64
+#define RING_NAP 50000L  /* nanoseconds to sleep waiting for the other side */
+
+char ring[RING_SIZE];
+unsigned long ring_head;     /* next byte to fill, owned by putch() */
+unsigned long ring_tail;     /* next byte to write, owned by the writer */
+unsigned long ring_room;     /* head may advance up to here without looking at tail */
+int ring_on = 0;
+int ring_stop = 0;
+int ring_asleep = 0;         /* the writer is waiting on ring_cond */
+pthread_t ring_thread;
+pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ring_cond = PTHREAD_COND_INITIALIZER;
+
+#define LOAD_ACQ(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE_REL(x,v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define LOAD_SC(x) __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define STORE_SC(x,v) __atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
+
+voidret ring_nap()
+{
+  struct timespec ts;
+  ts.tv_sec = 0;
+  ts.tv_nsec = RING_NAP;
+  nanosleep(&ts, NULL);
+}
+
+/* wake the writer if it is waiting for output. The fence orders the
+ * store of ring_head before the look at ring_asleep, as ring_wait()'s
+ * store of ring_asleep comes before its look at ring_head, so one of
+ * them sees the other. It costs a full fence, so ring_put() only comes
+ * here when the ring was empty, at a newline or when the ring is full.
+ */
+voidret ring_wake()
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (LOAD_SC(ring_asleep)) {
+    pthread_mutex_lock(&ring_lock);
+    pthread_cond_signal(&ring_cond);
+    pthread_mutex_unlock(&ring_lock);
+  }
+  return 0;
+}
+
+/* wait until there is output after tail, or the writer is to stop */
+voidret ring_wait(tail)
+unsigned long tail;
+{
+  pthread_mutex_lock(&ring_lock);
+  STORE_SC(ring_asleep, 1);
+  while (LOAD_SC(ring_head) == tail && !LOAD_SC(ring_stop))
+    pthread_cond_wait(&ring_cond, &ring_lock);
+  STORE_SC(ring_asleep, 0);
+  pthread_mutex_unlock(&ring_lock);
+  return 0;
+}
+
+void *ring_writer(arg)
+void *arg;
+{
+  unsigned long head, tail, len;
+  int idle = 0;
+  long n;
+
+  tail = ring_tail;
+  while (1) {
+    head = LOAD_ACQ(ring_head);
+    if (head == tail) {
+      if (LOAD_ACQ(ring_stop))
+        break;
+      if (++idle > RING_SPINS)
+        ring_wait(tail);
+      continue;
+    }
+    idle = 0;
+
+    /* write the contiguous part; a wrapped remainder goes next time round */
+    len = head - tail;
+    if (len > RING_SIZE - (tail & RING_MASK))
+      len = RING_SIZE - (tail & RING_MASK);
+    n = write(1, ring + (tail & RING_MASK), len);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      n = len; /* output is gone (closed pipe?); discard rather than wedge */
+    }
+    tail += n;
+    STORE_REL(ring_tail, tail);
+  }
+  return NULL;
+}
+
+voidret ring_put(c)
+uchar c;
+{
+  int spins = 0;
+
+  if (ring_head == ring_room) {
+    ring_wake();
+    while ((ring_room = LOAD_ACQ(ring_tail) + RING_SIZE) == ring_head) {
+      if (++spins > RING_SPINS)
+        ring_nap();
+    }
+  }
+  ring[ring_head & RING_MASK] = c;
+  STORE_REL(ring_head, ring_head+1);
+  /* the writer only sleeps once it has caught up. If a stale ring_tail
+   * misses that, the next character sees ring_asleep, or failing that
+   * the next newline or flush wakes it
+   */
+  if (c == NL || LOAD_ACQ(ring_tail) == ring_head-1 || LOAD_ACQ(ring_asleep))
+    ring_wake();
+  return 0;
+}
+
+voidret ring_drain()
+{
+  int spins = 0;
+
+  ring_wake();
+  while (LOAD_ACQ(ring_tail) != ring_head) {
+    if (++spins > RING_SPINS)
+      ring_nap();
+  }
+}
+
+voidret putstr(s)
+char *s;
+{
+  while (*s)
+    putch(*s++);
+}
+
+voidret outp(x,y)
+unsigned short x;
+char y;
+{
+  char buf[32];
+  sprintf(buf, "<OUTP %02X, %02X>", x, y);
+  putstr(buf);
+}
+
+uchar inp(x)
+unsigned short x;
+{
+  char buf[32];
+  sprintf(buf, "<INP %02X -> 0x33>", x);
+  putstr(buf);
+  return 0x33;
+}
+#endif
+
+/* turn asynchronous console output on or off. Turning it off drains
+ * everything queued so far. Returns 0 if the host doesn't support it.
+ */
+int async_output(on)
+int on;
+{
+#ifdef LINUX
+  if (on && !ring_on) {
+    fflush(stdout);
+    ring_stop = 0;
+    ring_room = ring_head + RING_SIZE;
+    if (pthread_create(&ring_thread, NULL, ring_writer, NULL) != 0)
+      return 0;
+    ring_on = 1;
+  } else if (!on && ring_on) {
+    ring_drain();
+    STORE_SC(ring_stop, 1);
+    pthread_mutex_lock(&ring_lock);
+    pthread_cond_signal(&ring_cond);
+    pthread_mutex_unlock(&ring_lock);
+    pthread_join(ring_thread, NULL);
+    ring_on = 0;
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* make sure everything putch()ed so far has reached the console. Called
+ * before reading input, after errors and on the way out.
+ */
+voidret flush_output()
+{
+#ifdef LINUX
+  if (ring_on) {
+    ring_drain();
+    return 0;
+  }
+#endif
+  fflush(stdout);
+}
+
+/* return 1 if raw_mode successfully enabled */
+voidret enable_raw_mode()
+{
+#ifdef DONOTUSE
+    /* there's really no reason for raw mode; everything seems to
+     *  work fine in cooked mode. So just avoid the nuisance...
+     */
+    struct termios term;
+    tcgetattr(0, &term);
+    term.c_lflag &= ~(ICANON | ECHO); // Disable echo as well
+    tcsetattr(0, TCSANOW, &term);
+    return 1;
+#endif
+  return 0; /* raw_mode unsupported */
+}
+
+voidret disable_raw_mode()
+{
+#ifdef DONOTUSE
+    struct termios term;
+    tcgetattr(0, &term);
+    term.c_lflag |= ICANON | ECHO;
+    tcsetattr(0, TCSANOW, &term);
+#endif
+}
+
+int kbhit() {
+#ifdef DONOTUSE
+    int byteswaiting;
+    ioctl(0, FIONREAD, &byteswaiting);
+    return byteswaiting > 0;
+#else
+  return 0;
+#endif
+}
+
+/* after a successful open_write, all putch() will go
+ * to the file
+ */
+int open_write(fn)
+char *fn;
+{
+  w_file = fopen(fn, "wt");
+  if (w_file == NULL) {
+    return 0;
+  } else {
+    return 1;
+  }
+}
+
+/* after a successful open_read, all getch() will come
+ * from the file
+ */
+int open_read(fn)
+char *fn;
+{
+  r_file = fopen(fn, "rt");
+  if (r_file == NULL) {
+    return 0;
+  } else {
+    return 1;
+  }
+}
+
+/* Numbered file channels for OPEN/PRINT#/INPUT#/CLOSE. They are
+ * independent of the LOAD/SAVE file above and of the console. On Linux
+ * each channel gets a large stdio buffer so streaming runs at disk speed.
+ */
+FILE *chan_file[NCHAN+1];   /* indexed by channel number, 0 unused */
+FILE *out_file = NULL;      /* set by select_output() while PRINT# runs */
+#ifdef LINUX
+#define CHANBUF_SIZE 65536
+char chan_buf[NCHAN+1][CHANBUF_SIZE];
+#endif
+
+/* open channel n (1..NCHAN) on a file; mode is 'r', 'w' or 'a'.
+ * Returns 0 if the channel is bad or the file can't be opened.
+ */
+int chan_open(n, fn, mode)
+int n;
+char *fn;
+char mode;
+{
+  char fmode[3];
+
+  if (n < 1 || n > NCHAN)
+    return 0;
+  chan_close(n);
+  fmode[0] = mode;
+  fmode[1] = 't';
+  fmode[2] = '\0';
+  chan_file[n] = fopen(fn, fmode);
+  if (chan_file[n] == NULL)
+    return 0;
+#ifdef LINUX
+  setvbuf(chan_file[n], chan_buf[n], _IOFBF, CHANBUF_SIZE);
+#endif
+  return 1;
+}
+
+/* close channel n, or every channel if n is 0 */
+voidret chan_close(n)
+int n;
+{
+  int i;
+
+  if (n == 0) {
+    for (i=1; i<=NCHAN; i++)
+      chan_close(i);
+    return 0;
+  }
+  if (n < 1 || n > NCHAN || chan_file[n] == NULL)
+    return 0;
+  if (out_file == chan_file[n])
+    out_file = NULL;
+  fclose(chan_file[n]);
+  chan_file[n] = NULL;
+}
+
+/* send putch() to channel n instead of the console; 0 selects the
+ * console again. Returns 0 if channel n isn't open.
+ */
+int select_output(n)
+int n;
+{
+  if (n == 0) {
+    out_file = NULL;
+    return 1;
+  }
+  if (n < 1 || n > NCHAN || chan_file[n] == NULL)
+    return 0;
+  out_file = chan_file[n];
+  return 1;
+}
+
+/* read a line from channel n into buf, replacing the line ending with NL.
+ * A line longer than max-1 characters is split. Returns 0 at end of file
+ * or if the channel isn't open.
+ */
+int chan_getln(n, buf, max)
+int n;
+uchar *buf;
+int max;
+{
+  FILE *f;
+  int c;
+  int len = 0;
+
+  if (n < 1 || n > NCHAN || chan_file[n] == NULL)
+    return 0;
+  f = chan_file[n];
+  while (len < max-1) {
+    c = getc(f);
+    if (c == EOF) {
+      if (len == 0)
+        return 0;
+      break;
+    }
+    if (c == '\n')
+      break;
+    if (c != '\r')
+      buf[len++] = c;
+  }
+  buf[len] = NL;
+  return 1;
+}
+
+/* 1 if there is nothing more to read on channel n (or it isn't open) */
+int chan_eof(n)
+int n;
+{
+  int c;
+
+  if (n < 1 || n > NCHAN || chan_file[n] == NULL)
+    return 1;
+  c = getc(chan_file[n]);
+  if (c == EOF)
+    return 1;
+  ungetc(c, chan_file[n]);
+  return 0;
+}
+
+voidret close_file()
+{
+  if (w_file != NULL) {
+    fclose(w_file);
+    w_file = NULL;
+  }
+  if (r_file != NULL) {
+    fclose(r_file);
+    r_file = NULL;
+  }
+}
+
+#ifdef LINUX
+/* Console input is read from fd 0 a block at a time. getch() takes one
+ * character from the block, getchunk() lets getln() copy a whole run of
+ * ordinary characters at once.
+ */
+#define INBUF_SIZE 65536
+uchar inbuf[INBUF_SIZE];
+int in_pos = 0;
+int in_len = 0;
+
+/* refill the input block; returns 0 at end of input */
+int in_fill()
+{
+  long n;
+
+  if (in_len < 0)
+    return 0;
+  do {
+    n = read(0, inbuf, INBUF_SIZE);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    in_len = -1; /* stay at EOF */
+    return 0;
+  }
+  in_pos = 0;
+  in_len = n;
+  return 1;
+}
+#endif
+
+/* Record and replay. With a trace open for recording, each console
+ * character, INP() value and RAND() value the program is given is also
+ * written to the trace file; replaying, they are taken from the trace
+ * instead, so a run goes exactly the way the recorded one did. A record
+ * is a tag byte and the value, high byte first. If a replay asks for
+ * something the trace doesn't hold next, it has gone another way: the
+ * rest of the run gets live values and trace_close() reports it.
+ */
+#define TR_KEY  'K'   /* a console character */
+#define TR_INP  'I'   /* an INP() value */
+#define TR_RAND 'R'   /* a RAND() value, two bytes */
+uchar tr_magic[] = "TBT1";
+
+FILE *tr_file;
+uchar tr_mode;   /* TRACE_RECORD, TRACE_REPLAY or 0 */
+uchar tr_off;    /* the replay has left the trace */
+
+char getch_live();
+unsigned short rand_next();
+
+int trace_open(fn, mode)
+char *fn;
+uchar mode;
+{
+  int i;
+
+  tr_file = fopen(fn, mode == TRACE_RECORD ? "wb" : "rb");
+  if (tr_file == NULL)
+    return 0;
+  for (i = 0; tr_magic[i]; i++) {
+    if (mode == TRACE_RECORD)
+      putc(tr_magic[i], tr_file);
+    else if (getc(tr_file) != tr_magic[i]) {
+      fclose(tr_file);
+      return 0;
+    }
+  }
+  tr_mode = mode;
+  return 1;
+}
+
+/* returns 0 if a replay didn't follow its trace to the end */
+int trace_close()
+{
+  int ok = !tr_off;
+
+  if (tr_file == NULL)
+    return 1;
+  if (tr_mode == TRACE_REPLAY && getc(tr_file) != EOF)
+    ok = 0;
+  fclose(tr_file);
+  tr_file = NULL;
+  tr_mode = 0;
+  return ok;
+}
+
+voidret trace_put(tag, v, n)
+uchar tag;
+unsigned short v;
+int n;
+{
+  putc(tag, tr_file);
+  if (n > 1)
+    putc(v >> 8, tr_file);
+  putc(v & 0xFF, tr_file);
+}
+
+/* the next value, if it's an n byte tag record; 0 if it isn't */
+int trace_get(tag, v, n)
+uchar tag;
+unsigned short *v;
+int n;
+{
+  int c = getc(tr_file);
+  int hi = 0;
+
+  if (c == tag && n > 1)
+    hi = getc(tr_file);
+  if (c == tag && hi != EOF && (c = getc(tr_file)) != EOF) {
+    *v = (hi << 8) | c;
+    return 1;
+  }
+  tr_off = 1;
+  tr_mode = 0;
+  return 0;
+}
+
+/* returns EOFC at end of file or end of input */
+char getch()
+{
+  unsigned short v;
+  char c;
+
+  if (r_file != NULL || tr_mode == 0)
+    return getch_live();
+  if (tr_mode == TRACE_REPLAY && trace_get(TR_KEY, &v, 1))
+    return v;
+  c = getch_live();
+  if (tr_mode == TRACE_RECORD)
+    trace_put(TR_KEY, c & 0xFF, 1);
+  return c;
+}
+
+/* an INP() for the program */
+uchar host_inp(x)
+unsigned short x;
+{
+  unsigned short v;
+
+  if (tr_mode == TRACE_REPLAY && trace_get(TR_INP, &v, 1))
+    return v;
+  v = inp(x) & 0xFF;
+  if (tr_mode == TRACE_RECORD)
+    trace_put(TR_INP, v, 1);
+  return v;
+}
+
+#ifndef LINUX
+unsigned short key_mix;  /* the keys typed so far, for host_seed() */
+#endif
+
+char getch_live()
+{
+  int c;
+  if (r_file != NULL) {
+    c = fgetc(r_file);
+  } else {
+#ifdef LINUX
+    if (in_pos >= in_len && !in_fill())
+      return EOFC;
+    return inbuf[in_pos++];
+#else
+    c = getchar();
+    key_mix = key_mix * 31 + c;
+#endif
+  }
+  if (c == EOF)
+    return EOFC;
+  return c;
+}
+
+/* copy up to max characters of console input that need no special
+ * handling (no control characters) to dest, without blocking for more
+ * than one read. Returns how many were copied; the caller falls back
+ * to getch() for anything else.
+ */
+int getchunk(dest, max)
+uchar *dest;
+int max;
+{
+#ifdef LINUX
+  int n = 0;
+  uchar c;
+
+  if (r_file != NULL)
+    return 0;
+  if (tr_mode == TRACE_REPLAY)
+    return 0;  /* one getch() at a time, from the trace */
+  if (in_pos >= in_len && !in_fill())
+    return 0;
+  while (n < max && in_pos < in_len) {
+    c = inbuf[in_pos];
+    if ((c < ' ' && c != '\t') || c == '\177')
+      break;
+    dest[n++] = c;
+    in_pos++;
+    if (tr_mode == TRACE_RECORD)
+      trace_put(TR_KEY, c & 0xFF, 1);
+  }
+  return n;
+#else
+  return 0;
+#endif
+}
+
+#ifndef NOSTATS
+long stat_putch;  /* putch() calls, for STATS */
+#endif
+
+voidret putch(c)
+uchar c;
+{
+  STAT(stat_putch++);
+  if (out_file) {
+    putc(c, out_file);
+  } else if (w_file) {
+    fputc(c, w_file);
+#ifdef LINUX
+  } else if (ring_on) {
+    ring_put(c);
+#endif
+  } else {
+    putchar(c);
+  }
+}
+
+voidret put_nl()
+{
+#ifndef LINUX
+  putch(CR);
+#endif	
+  putch(NL);
+}
+
+voidret poke(x,y)
+unsigned short x;
+uchar y;
+{
+  memory[x] = y;
+}
+
+uchar peek(x)
+unsigned short x;
+{
+  return memory[x];
+}
+
+/* Whole-array kernels for the MAT statement. Arrays are n 16-bit words
+ * in memory[]; arithmetic wraps at 16 bits exactly as it does for
+ * single elements. The destination may be the same array as a source.
+ * With gcc on Linux they work eight words at a time (SSE2 on x86-64).
+ */
+voidret mat_op(op, d, a, b, n)
+char op;
+short int *d;
+short int *a;
+short int *b;
+unsigned int n;
+{
+  unsigned int i = 0;
+
+#ifdef MAT_SIMD
+  if (op == '+') {
+    for (; i+8 <= n; i += 8)
+      *(v8hi *)(d+i) = *(v8hi *)(a+i) + *(v8hi *)(b+i);
+  } else if (op == '-') {
+    for (; i+8 <= n; i += 8)
+      *(v8hi *)(d+i) = *(v8hi *)(a+i) - *(v8hi *)(b+i);
+  } else {
+    for (; i+8 <= n; i += 8)
+      *(v8hi *)(d+i) = *(v8hi *)(a+i) * *(v8hi *)(b+i);
+  }
+#endif
+  for (; i < n; i++) {
+    if (op == '+')
+      d[i] = a[i] + b[i];
+    else if (op == '-')
+      d[i] = a[i] - b[i];
+    else
+      d[i] = a[i] * b[i];
+  }
+}
+
+voidret mat_scale(d, a, k, n)
+short int *d;
+short int *a;
+short int k;
+unsigned int n;
+{
+  unsigned int i = 0;
+
+#ifdef MAT_SIMD
+  v8hi kk = {k, k, k, k, k, k, k, k};
+  for (; i+8 <= n; i += 8)
+    *(v8hi *)(d+i) = *(v8hi *)(a+i) * kk;
+#endif
+  for (; i < n; i++)
+    d[i] = a[i] * k;
+}
+
+voidret mat_fill(d, k, n)
+short int *d;
+short int k;
+unsigned int n;
+{
+  unsigned int i = 0;
+
+#ifdef MAT_SIMD
+  v8hi kk = {k, k, k, k, k, k, k, k};
+  for (; i+8 <= n; i += 8)
+    *(v8hi *)(d+i) = kk;
+#endif
+  for (; i < n; i++)
+    d[i] = k;
+}
+
+voidret mat_copy(d, a, n)
+short int *d;
+short int *a;
+unsigned int n;
+{
+  unsigned int i = 0;
+
+  if (d == a)
+    return 0;
+#ifdef MAT_SIMD
+  for (; i+8 <= n; i += 8)
+    *(v8hi *)(d+i) = *(v8hi *)(a+i);
+#endif
+  for (; i < n; i++)
+    d[i] = a[i];
+}
+
+/* Block operations on memory[] for MEMCPY, MEMSET and the checksum
+ * functions. Addresses are memory[] offsets; a range that doesn't fit
+ * inside MEMSIZE is refused before anything is touched.
+ */
+int mem_range(addr, n)
+unsigned short addr;
+unsigned short n;
+{
+  return (long)addr + n <= MEMSIZE;
+}
+
+/* copy n bytes, overlapping ranges allowed; returns 0 if out of range */
+int mem_copy(dst, src, n)
+unsigned short dst;
+unsigned short src;
+unsigned short n;
+{
+  if (!mem_range(dst, n) || !mem_range(src, n))
+    return 0;
+#ifdef LINUX
+  memmove(memory+dst, memory+src, n);
+#else
+  if (dst < src) {
+    while (n--)
+      memory[dst++] = memory[src++];
+  } else {
+    while (n--)
+      memory[dst+n] = memory[src+n];
+  }
+#endif
+  return 1;
+}
+
+/* set n bytes to val; returns 0 if out of range */
+int mem_set(dst, val, n)
+unsigned short dst;
+uchar val;
+unsigned short n;
+{
+  if (!mem_range(dst, n))
+    return 0;
+#ifdef LINUX
+  memset(memory+dst, val, n);
+#else
+  while (n--)
+    memory[dst++] = val;
+#endif
+  return 1;
+}
+
+/* 16-bit sum of n bytes, caller checks the range */
+unsigned short mem_sum(addr, n)
+unsigned short addr;
+unsigned short n;
+{
+  unsigned short sum = 0;
+  uchar *p = memory+addr;
+
+  while (n--)
+    sum += *p++ & 0xFF;
+  return sum;
+}
+
+/* CRC-16/CCITT (poly 0x1021, initial value 0xFFFF) of n bytes, a byte
+ * at a time from a table built on first use. Caller checks the range.
+ */
+unsigned short crc_table[256];
+int crc_ready = 0;
+
+unsigned short mem_crc(addr, n)
+unsigned short addr;
+unsigned short n;
+{
+  unsigned short crc = 0xFFFF;
+  unsigned short c;
+  uchar *p = memory+addr;
+  int i, j;
+
+  if (!crc_ready) {
+    for (i=0; i<256; i++) {
+      c = i << 8;
+      for (j=0; j<8; j++)
+        c = (c & 0x8000) ? (c << 1) ^ 0x1021 : (c << 1);
+      crc_table[i] = c;
+    }
+    crc_ready = 1;
+  }
+  while (n--)
+    crc = (crc << 8) ^ crc_table[((crc >> 8) ^ *p++) & 0xFF];
+  return crc;
+}
+
+long seed = 1;                    /* Park-Miller state, used with -R */
+unsigned long rng_state = 2463534242UL; /* xorshift state, never 0 */
+uchar rng_legacy = 0;
+
+/* select the original Park-Miller generator, so that runs recorded with
+ * earlier versions repeat exactly
+ */
+voidret rand_legacy(on)
+uchar on;
+{
+    rng_legacy = on;
+}
+
+/* restart both generators from s */
+voidret randomize(s)
+unsigned short s;
+{
+    seed = s ? s : 1;
+    rng_state = ((unsigned long)s << 16) ^ 2463534242UL;
+}
+
+/* random number from 0 to amount-1, the generator's or the trace's */
+unsigned short rand(amount)
+unsigned short amount;
+{
+    unsigned short v;
+
+    if (tr_mode == TRACE_REPLAY && trace_get(TR_RAND, &v, 2))
+        return v;
+    v = rand_next(amount);
+    if (tr_mode == TRACE_RECORD)
+        trace_put(TR_RAND, v, 2);
+    return v;
+}
+
+/* random number from 0 to amount-1 - may be machine dependent */
+unsigned short rand_next(amount)
+unsigned short amount;
+{
+    long int a = 16807L, m = 2147483647L, q = 127773L, r = 2836L;
+    long int lo, hi, test;
+    unsigned long x;
+
+    if (amount == 0)
+        return 0;
+
+    if (rng_legacy) {
+        hi = seed / q;
+        lo = seed % q;
+        test = a * lo - r * hi;
+        if (test > 0)
+            seed = test; /* test for overflow */
+        else
+            seed = test + m;
+        return(seed % amount);
+    }
+
+    /* 32-bit xorshift, then scale the top 16 bits into range with a
+     * multiply and shift rather than a divide
+     */
+    x = rng_state;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    rng_state = x;
+    return ((x >> 16) * amount) >> 16;
+}
+
+/* fill n words with random numbers from 0 to amount-1 */
+voidret rand_fill(d, amount, n)
+short int *d;
+unsigned short amount;
+unsigned int n;
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        d[i] = rand(amount);
+}
+
+/* Native function registry. A host, or a program embedding the
+ * interpreter, registers C functions with native_register() before BASIC
+ * runs, and expressions then call them by name like the built in
+ * functions, eg MAX(A, B). A function is passed its arguments as an array
+ * of words and returns a word. Names are two or more capital letters and
+ * must not begin with the name of a built in function, which is looked up
+ * first.
+ */
+char *native_name[NATIVE_MAX];
+uchar native_arity[NATIVE_MAX];
+native_fn native_func[NATIVE_MAX];
+int native_count = 0;
+
+/* returns the function's index, or -1 if the table is full or the name or
+ * arity is unusable
+ */
+int native_register(name, arity, fn)
+char *name;
+int arity;
+native_fn fn;
+{
+  char *p;
+
+  if (native_count >= NATIVE_MAX || arity < 0 || arity > NATIVE_ARGS)
+    return -1;
+  for (p = name; *p; p++)
+    if (*p < 'A' || *p > 'Z')
+      return -1;
+  if (p - name < 2)
+    return -1;
+  native_name[native_count] = name;
+  native_arity[native_count] = arity;
+  native_func[native_count] = fn;
+  return native_count++;
+}
+
+/* the index of the registered function named at *s, advancing *s past
+ * the name, or -1
+ */
+int native_match(s)
+uchar **s;
+{
+  int i;
+  char *n;
+  uchar *t;
+
+  for (i = 0; i < native_count; i++) {
+    n = native_name[i];
+    t = *s;
+    while (*n && *t == *n) {
+      n++;
+      t++;
+    }
+    if (*n == 0 && (*t < 'A' || *t > 'Z')) {
+      *s = t;
+      return i;
+    }
+  }
+  return -1;
+}
+
+short int native_call(i, args)
+int i;
+short int *args;
+{
+  return (*native_func[i])(args);
+}
+
+short int native_min(args)
+short int *args;
+{
+  return args[0] < args[1] ? args[0] : args[1];
+}
+
+short int native_max(args)
+short int *args;
+{
+  return args[0] > args[1] ? args[0] : args[1];
+}
+
+/* the native functions every host provides; add host specific ones here */
+voidret host_natives()
+{
+  native_register("MIN", 2, native_min);
+  native_register("MAX", 2, native_max);
+}
+
+/* milliseconds since some arbitrary point, used for run time limits.
+ * Hosts without a clock return 0, which disables the limit.
+ */
+long host_millis()
+{
+#ifdef LINUX
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000L + ts.tv_nsec/1000000L;
+#else
+  return 0;
+#endif
+}
+
+/* a seed for RANDOMIZE alone: the clock, or on hosts without one the
+ * keys typed at the console so far, which vary from session to session
+ * but repeat if the same things are typed
+ */
+unsigned short host_seed()
+{
+#ifdef LINUX
+  return (unsigned short)host_millis();
+#else
+  return key_mix;
+#endif
+}
+
+/* the number of processors a PARFOR can use */
+int host_cpus()
+{
+#ifdef LINUX
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#else
+  return 1;
+#endif
+}
+
+#ifdef LINUX
+voidret (*par_fn)();
+int par_arg[PAR_MAX];
+
+void *par_start(arg)
+void *arg;
+{
+  par_fn(*(int *)arg);
+  return NULL;
+}
+#endif
+
+/* call fn(0) to fn(n-1), n at most PAR_MAX, each on a thread of its own
+ * where the host has threads, and wait for them all to return
+ */
+voidret host_parallel(fn, n)
+voidret (*fn)();
+int n;
+{
+  int i;
+#ifdef LINUX
+  pthread_t t[PAR_MAX];
+  char made[PAR_MAX];
+
+  par_fn = fn;
+  for (i = 1; i < n; i++) {
+    par_arg[i] = i;
+    made[i] = pthread_create(&t[i], NULL, par_start, &par_arg[i]) == 0;
+    if (!made[i])
+      fn(i);
+  }
+  fn(0);
+  for (i = 1; i < n; i++)
+    if (made[i])
+      pthread_join(t[i], NULL);
+#else
+  for (i = 0; i < n; i++)
+    fn(i);
+#endif
+}
+
+#ifdef LINUX
+voidret (*prof_fn)();
+
+void prof_signal(sig)
+int sig;
+{
+  prof_fn();
+}
+#endif
+
+/* call fn() hz times a second of processor time, from a signal handler,
+ * until host_profile(0, fn) stops it; returns 0 if the host can't
+ */
+int host_profile(hz, fn)
+int hz;
+voidret (*fn)();
+{
+#ifdef LINUX
+  struct sigaction sa;
+  struct itimerval it;
+
+  memset(&it, 0, sizeof(it));
+  if (hz > 0) {
+    prof_fn = fn;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = prof_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) != 0)
+      return 0;
+    it.it_interval.tv_usec = 1000000 / hz;
+    it.it_value = it.it_interval;
+  }
+  return setitimer(ITIMER_PROF, &it, NULL) == 0;
+#else
+  return 0;
+#endif
+}
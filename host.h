@@ -1,41 +1,106 @@
-/* set this to the amount of program memory to reserve for programs and variables */
-#define MEMSIZE 32768
-
-/* maximum size of a filename */
-#define FNSIZE 32
-
-/* zcc hates the static keyword */
-#define static /**/
-
-/* zcc gets wound up if you use const */
-#define const /**/
-
-/* zcc isn't very fond of unsigned applied to char */
-typedef char uchar;
-
-/* zcc seems to really dislike the void keyword; also dislikes funcs that don't declare a return kind */
-typedef int voidret;
-
-/* this holds the program and variable memory */
-extern uchar memory[MEMSIZE];
-
-#define CR	'\r'
-#define NL	'\n'
-#define EOFC 0x1A
-
-/* for port input/output */
-voidret outp(x,y);
-uchar inp(x);
-
-int enable_raw_mode();
-voidret disable_raw_mode();
-int kbhit();
-char getch();
-voidret putch(c);
-voidret put_nl();
-voidret poke(x,y);
-uchar peek(x);
-int open_write(fn);
-int open_read(fn);
-voidret close_file();
-unsigned short rand(amount);
+/* set this to the amount of program memory to reserve for programs and variables */
+#define MEMSIZE 32768
+
+/* maximum size of a filename */
+#define FNSIZE 32
+
+/* number of file channels for OPEN, numbered 1 to NCHAN */
+#define NCHAN 8
+
+/* registered native functions, see native_register() in host.c */
+#define NATIVE_MAX 16
+#define NATIVE_ARGS 4
+
+/* threads a PARFOR is split across, see host_parallel() in host.c */
+#define PAR_MAX 64
+
+/* the counters STATS reports, see stats_show() in tbasic.c. Build with
+ * -DNOSTATS to leave them out.
+ */
+#ifdef NOSTATS
+#define STAT(x)
+#else
+#define STAT(x) x
+#endif
+
+/* room for the compiled form of a program, see compile() in tbasic.c */
+#define CMP_NODES 8192
+#define CMP_STMTS 2048
+
+/* zcc hates the static keyword */
+#define static /**/
+
+/* zcc gets wound up if you use const */
+#define const /**/
+
+/* zcc isn't very fond of unsigned applied to char */
+typedef char uchar;
+
+/* zcc seems to really dislike the void keyword; also dislikes funcs that don't declare a return kind */
+typedef int voidret;
+
+/* this holds the program and variable memory */
+extern uchar memory[MEMSIZE];
+
+#define CR	'\r'
+#define NL	'\n'
+#define EOFC 0x1A
+
+/* for port input/output */
+voidret outp(x,y);
+uchar inp(x);
+uchar host_inp(x);
+
+/* record and replay, see trace_open() in host.c */
+#define TRACE_RECORD 1
+#define TRACE_REPLAY 2
+int trace_open(fn, mode);
+int trace_close();
+
+int enable_raw_mode();
+voidret disable_raw_mode();
+int kbhit();
+char getch();
+int getchunk(dest, max);
+voidret putch(c);
+#ifndef NOSTATS
+extern long stat_putch;
+#endif
+voidret put_nl();
+int async_output(on);
+voidret flush_output();
+voidret poke(x,y);
+uchar peek(x);
+int open_write(fn);
+int open_read(fn);
+voidret close_file();
+int chan_open(n, fn, mode);
+voidret chan_close(n);
+int select_output(n);
+int chan_getln(n, buf, max);
+int chan_eof(n);
+voidret mat_op(op, d, a, b, n);
+voidret mat_scale(d, a, k, n);
+voidret mat_fill(d, k, n);
+voidret mat_copy(d, a, n);
+int mem_range(addr, n);
+int mem_copy(dst, src, n);
+int mem_set(dst, val, n);
+unsigned short mem_sum(addr, n);
+unsigned short mem_crc(addr, n);
+voidret rand_legacy(on);
+voidret randomize(s);
+unsigned short rand(amount);
+voidret rand_fill(d, amount, n);
+long host_millis();
+unsigned short host_seed();
+int host_cpus();
+voidret host_parallel(fn, n);
+int host_profile(hz, fn);
+
+typedef short int (*native_fn)();
+extern uchar native_arity[NATIVE_MAX];
+int native_register(name, arity, fn);
+int native_match(s);
+short int native_call(i, args);
+voidret host_natives();
@@ -0,0 +1,1699 @@
+/*  ir.c : optimizes and runs the compiled form of a program
+
+ RUN compiles the program (see compile() in tbasic.c and tbasic.h) and
+ optimizes the result. Operators and functions whose operands are all
+ constants are worked out once, wrapping to 16 bits as the interpreter
+ does; a division by zero or the SQR() of a negative number is left for
+ the program to run into. An IF whose condition is then a constant
+ either goes away or becomes a jump to the next line, and the rest of
+ its line, which can't be reached, is dropped. The program text is
+ left alone, so LIST and SAVE show what was typed.
+
+ loop() hands every line it starts to ir_run(), which runs as many of
+ the compiled statements as it can: LET, IF, GOTO, GOSUB, RETURN, FOR,
+ NEXT, REM, END and PRINT to the console, with expressions that don't
+ do anything besides giving a value. It works out everything a
+ statement needs before doing any of it, so at any other statement, or
+ at one that goes wrong, it can stop at the start of the statement and
+ leave it to the interpreter, which runs it as if ir_run() had never
+ been there, error messages and all. It also stops every IR_SPAN
+ statements so that loop() can look for the break key.
+
+ A few statements that are very common are recognized when the program
+ is optimized and run by handlers of their own, which don't evaluate
+ any expression trees (superinstructions):
+	IF var relop const GOTO line
+	var=var+const, and var-const
+	FOR var=const TO ..., which needn't work out its start
+	NEXT var, when the loop is the innermost one
+ ir_fired[] counts how often each one runs, for -v.
+
+ A FOR loop whose body is a line holding just A(I+c)=expression, with I
+ the loop variable, followed by NEXT I, doesn't depend on what earlier
+ times round did as long as the expression reads A only at the element
+ being set and calls no function that reads memory, such as PEEK().
+ Such a loop is vectorized: ir_vector() checks the bounds of
+ every array it touches once for the whole loop, then works the
+ expression out IR_VEC elements at a time, each node in one pass over
+ memory[]. The variable ends up with the value the interpreter would
+ have left in it.
+
+ Other FOR loops made only of statements ir_run() runs, other than
+ GOSUB, RETURN and END, are found by ir_loopscan(). The largest parts of
+ their expressions that the loop doesn't change become X_HOIST nodes,
+ worked out by ir_enter() when the loop starts, and an element I+c of
+ the loop variable I, if only the loop's NEXT changes I, is checked
+ against the bounds there for every value I will take. These hold while
+ ir_on[] is set for the loop: a jump that may leave it, the end of the
+ loop and every return to loop() clear it, so a jump back into the body
+ sees the expressions as they were compiled.
+
+ ir_parfor() runs the iterations of a PARFOR on host_parallel()'s
+ threads. ir_eval() reads the variables through ir_vars and reports
+ through ir_err, which each thread has its own of, so a worker can run
+ the body with a copy of the variables while sharing the arrays.
+*/
+
+#include <stdio.h>
+#include "host.h"
+#include "tbasic.h"
+
+#define IR_SPAN  4096   /* statements between looks at the break key */
+#define IR_ITEMS 16     /* numbers in a PRINT */
+#define IR_VEC   64     /* elements a vectorized loop works on at a time */
+#define IR_LOOPS 255    /* FOR loops looked at, see ir_loopscan() */
+#define IR_HOIST 256    /* values hoisted out of loops */
+#define IR_CHECKS 256   /* array accesses checked once per loop */
+
+/* what the PARFOR workers each have their own of */
+#ifdef LINUX
+#define IR_OWN __thread
+#else
+#define IR_OWN
+#endif
+
+/* superinstructions */
+#define F_NONE   0
+#define F_IFGOTO 1
+#define F_INC    2
+#define F_FOR    3
+#define F_NEXT   4
+#define F_VEC    5   /* a vectorized FOR loop */
+#define F_KINDS  6
+
+uchar ir_prog;                 /* cmp_stmt[] holds the program: 1, or 2 if it can't */
+uchar ir_can[CMP_STMTS];       /* 1 if ir_run() runs the statement */
+uchar ir_mark[CMP_NODES];
+short int ir_removed;          /* nodes the optimizer took out */
+IR_OWN uchar ir_err;           /* set by ir_eval() for anything that goes wrong */
+IR_OWN short int *ir_vars;     /* the variables ir_eval() reads */
+uchar *ir_head_line[26];       /* the FOR line of each variable's loop */
+short int ir_head[26];         /* and the statement after it */
+uchar ir_fuse[CMP_STMTS];      /* the superinstruction of each statement, F_* */
+short int ir_k[CMP_STMTS];     /* the constant an F_INC adds */
+long ir_fired[F_KINDS];
+uchar ir_shown;                /* ir_counts() has reported them */
+short int ir_at;               /* 1 + the statement ir_run() is at, 0 outside it */
+short int ir_loops;
+short int ir_lfor[IR_LOOPS];   /* the FOR of each loop */
+short int ir_lnext[IR_LOOPS];  /* the NEXT that ends it */
+short int ir_lup[IR_LOOPS];    /* the loop it is in, -1 for none */
+uchar ir_lok[IR_LOOPS];        /* what can be done for it, see ir_sets() */
+short int ir_lh[IR_LOOPS+1];   /* its hoisted values are from ir_lh[L] to ir_lh[L+1] */
+uchar ir_on[IR_LOOPS];         /* 1 from its start until control leaves it */
+uchar ir_inb[IR_LOOPS];        /* its array accesses are known to be in bounds */
+uchar ir_any;                  /* some loop is on */
+short int ir_hoists;
+short int ir_hnode[IR_HOIST];  /* the X_HOIST node of each value */
+short int ir_hval[IR_HOIST];
+uchar ir_hok[IR_HOIST];        /* 0 if working it out went wrong */
+short int ir_checks;
+short int ir_bnode[IR_CHECKS]; /* X_ELEM nodes checked by a loop, in val */
+uchar ir_exit[CMP_STMTS];      /* 1 if the jump of a statement may leave a loop */
+const uchar *ir_fnames[F_KINDS] = { "", "IF var relop const GOTO", "var=var+const",
+	"FOR var=const TO", "NEXT var", "vectorized FOR loop" };
+
+extern uchar *current_line;
+extern uchar *txtpos;
+extern uchar *stack_limit;
+extern unsigned short linenum;
+extern uchar no_jit;
+uchar *findline();
+short int elem_get();
+voidret elem_put();
+short int *arrptr();
+
+/***************************************************************************/
+/* the expressions of statement st, -1 for none */
+voidret ir_roots(st, r)
+struct cstmt *st;
+short int *r;
+{
+	r[0] = st->a;
+	r[1] = st->b;
+	r[2] = st->c;
+	if (st->op == S_TEXT || st->op == S_DIM)
+		r[2] = -1;
+	if (st->op == S_MAT)
+		r[0] = r[1] = -1;
+}
+
+voidret ir_markx(x)
+short int x;
+{
+	while (x >= 0 && !ir_mark[x]) {
+		ir_mark[x] = 1;
+		if (cmp_node[x].op == X_STR)
+			return 0;
+		ir_markx(cmp_node[x].a);
+		x = cmp_node[x].b;
+	}
+}
+
+/* the number of nodes the statements use */
+short int ir_live()
+{
+	short int r[3];
+	short int i, n;
+
+	for (i=0; i<cmp_nodes; i++)
+		ir_mark[i] = 0;
+	for (i=0; i<cmp_stmts; i++) {
+		ir_roots(cmp_stmt + i, r);
+		for (n=0; n<3; n++)
+			ir_markx(r[n]);
+	}
+	n = 0;
+	for (i=0; i<cmp_nodes; i++)
+		n += ir_mark[i];
+	return n;
+}
+
+/***************************************************************************/
+/* a op b for the operators from X_ADD on, or ~a for X_NOT */
+short int ir_op(op, a, b)
+uchar op;
+short int a;
+short int b;
+{
+	switch (op) {
+		case X_NOT: return ~a;
+		case X_ADD: return a + b;
+		case X_SUB: return a - b;
+		case X_MUL: return a * b;
+		case X_DIV:
+		case X_MOD:
+			if (b == 0) {
+				ir_err = 1;
+				return 0;
+			}
+			return op == X_DIV ? a / b : a % b;
+		case X_SHL:
+		case X_SHR:
+			if (b < 0 || b > 15)
+				return 0;
+			if (op == X_SHL)
+				return (unsigned short)a << b;
+			return (unsigned short)a >> b;
+		case X_GE: return a >= b;
+		case X_NE: return a != b;
+		case X_GT: return a > b;
+		case X_EQ: return a == b;
+		case X_LE: return a <= b;
+		case X_LT: return a < b;
+		case X_AND: return a & b;
+		case X_OR: return a | b;
+		case X_XOR: return a ^ b;
+	}
+	ir_err = 1;
+	return 0;
+}
+
+/* built in function f of a and b, b being the second argument of ATN() */
+short int ir_func(f, a, b)
+uchar f;
+short int a;
+short int b;
+{
+	switch (f) {
+		case FUNC_PEEK: return peek(a);
+		case FUNC_ABS: return a < 0 ? -a : a;
+		case FUNC_FRE: return sp - image_end;
+		case FUNC_SIN: return sin_deg(a);
+		case FUNC_COS: return sin_deg(a % 360 + 90);
+		case FUNC_ATN: return atn_deg(a, b);
+		case FUNC_SQR:
+			if (a >= 0)
+				return isqrt(a);
+			break;
+	}
+	ir_err = 1;
+	return 0;
+}
+
+/* 1 if function f always gives the same value for the same arguments */
+uchar ir_const_fn(f)
+uchar f;
+{
+	return f == FUNC_ABS || f == FUNC_SIN || f == FUNC_COS || f == FUNC_ATN
+		|| f == FUNC_SQR;
+}
+
+/* 1 if node x is something ir_eval() can work out */
+uchar ir_pure(x)
+short int x;
+{
+	struct cnode *n;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_VAR:
+				return 1;
+			case X_STR:
+			case X_NATIVE:
+				return 0;
+			case X_FUNC:
+				if (!ir_const_fn(n->n) && n->n != FUNC_PEEK && n->n != FUNC_FRE)
+					return 0;
+				break;
+		}
+		if (!ir_pure(n->a))
+			return 0;
+		x = n->b;
+	}
+	return 1;
+}
+
+/***************************************************************************/
+/* Work out node x if its operands are constants; returns 1 if it did */
+uchar ir_fold(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+	struct cnode *a, *b;
+	short int v;
+
+	if (n->op == X_NOT || n->op >= X_ADD) {
+		a = cmp_node + n->a;
+		b = n->op == X_NOT ? a : cmp_node + n->b;
+		if (a->op != X_NUM || b->op != X_NUM)
+			return 0;
+		ir_err = 0;
+		v = ir_op(n->op, a->val, b->val);
+	}
+	else if (n->op == X_FUNC && ir_const_fn(n->n)) {
+		/* the arguments are a list of one or two */
+		a = cmp_node + cmp_node[n->a].a;
+		v = ONE_Q14;
+		if (cmp_node[n->a].b >= 0) {
+			b = cmp_node + cmp_node[cmp_node[n->a].b].a;
+			if (b->op != X_NUM)
+				return 0;
+			v = b->val;
+		}
+		if (a->op != X_NUM)
+			return 0;
+		ir_err = 0;
+		v = ir_func(n->n, a->val, v);
+	}
+	else
+		return 0;
+	if (ir_err)
+		return 0;
+	n->op = X_NUM;
+	n->val = v;
+	n->a = n->b = -1;
+	return 1;
+}
+
+/***************************************************************************/
+/* Sets *c if x is the index I+c, I-c or c+I of the loop variable v */
+uchar ir_affine(x, v, c)
+short int x;
+short int v;
+long *c;
+{
+	struct cnode *n = cmp_node + x;
+	struct cnode *l = cmp_node + n->a;
+	struct cnode *r = cmp_node + n->b;
+
+	if (n->op == X_VAR && n->n == v) {
+		*c = 0;
+		return 1;
+	}
+	if (n->op != X_ADD && n->op != X_SUB)
+		return 0;
+	if (l->op == X_VAR && l->n == v && r->op == X_NUM) {
+		*c = n->op == X_ADD ? (long)r->val : -(long)r->val;
+		return 1;
+	}
+	if (n->op == X_ADD && r->op == X_VAR && r->n == v && l->op == X_NUM) {
+		*c = l->val;
+		return 1;
+	}
+	return 0;
+}
+
+/* 1 if variable v or array w is used in x */
+uchar ir_mentions(x, v, w)
+short int x;
+short int v;
+short int w;
+{
+	struct cnode *n;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_STR:
+				return 0;
+			case X_VAR:
+				return n->n == v;
+			case X_ELEM:
+				if (n->n == w)
+					return 1;
+				break;
+		}
+		if (ir_mentions(n->a, v, w))
+			return 1;
+		x = n->b;
+	}
+	return 0;
+}
+
+/* 1 if x can be worked out for all the times round the loop of variable
+ * v at once, the loop setting element I+c of array w
+ */
+uchar ir_vecok(x, v, w, c)
+short int x;
+short int v;
+short int w;
+long c;
+{
+	struct cnode *n = cmp_node + x;
+	long d;
+
+	switch (n->op) {
+		case X_NUM:
+		case X_VAR:
+			return 1;
+		case X_ELEM:
+			if (n->b < 0 && ir_affine(n->a, v, &d))
+				return n->n != w || d == c;
+			/* the same element every time round */
+			return !ir_mentions(x, v, w);
+		case X_FUNC:
+			/* PEEK(), MEMSUM() and the like could read what an
+			 * earlier iteration wrote */
+			if (!ir_const_fn(n->n))
+				return 0;
+			for (x=n->a; x >= 0; x = cmp_node[x].b)
+				if (!ir_vecok(cmp_node[x].a, v, w, c))
+					return 0;
+			return 1;
+	}
+	return ir_vecok(n->a, v, w, c) && (n->b < 0 || ir_vecok(n->b, v, w, c));
+}
+
+/* 1 if the loop of the FOR statement s can be vectorized */
+uchar ir_vecable(s)
+short int s;
+{
+	struct cstmt *st = cmp_stmt + s;
+	struct cnode *t;
+	long c;
+
+	if (s+2 >= cmp_stmts || !ir_can[s+1] || !ir_can[s+2])
+		return 0;
+	if (st[1].op != S_LET || st[1].next_line != s+2)
+		return 0;
+	if (st[2].op != S_NEXT || st[2].n != 'A' + st->n)
+		return 0;
+	t = cmp_node + st[1].a;
+	return t->op == X_ELEM && t->b < 0 && ir_affine(t->a, st->n, &c)
+		&& ir_vecok(st[1].b, st->n, t->n, c);
+}
+
+/* the superinstruction statement s can be run as, F_NONE for none */
+uchar ir_super(s)
+short int s;
+{
+	struct cstmt *st = cmp_stmt + s;
+	struct cnode *t = cmp_node + st->a;
+	struct cnode *u;
+
+	switch (st->op) {
+		case S_IF:
+			if (t->op >= X_GE && t->op <= X_LT && cmp_node[t->a].op == X_VAR
+					&& cmp_node[t->b].op == X_NUM && s+1 < st->next_line
+					&& st[1].op == S_GOTO && st[1].target >= 0)
+				return F_IFGOTO;
+			break;
+		case S_LET:
+			u = cmp_node + st->b;
+			if (t->op != X_VAR || u->op != X_ADD && u->op != X_SUB)
+				break;
+			if (cmp_node[u->a].op == X_VAR && cmp_node[u->a].n == t->n
+					&& cmp_node[u->b].op == X_NUM) {
+				ir_k[s] = u->op == X_ADD ? cmp_node[u->b].val : -cmp_node[u->b].val;
+				return F_INC;
+			}
+			if (u->op == X_ADD && cmp_node[u->b].op == X_VAR && cmp_node[u->b].n == t->n
+					&& cmp_node[u->a].op == X_NUM) {
+				ir_k[s] = cmp_node[u->a].val;
+				return F_INC;
+			}
+			break;
+		case S_FOR:
+			if (ir_vecable(s))
+				return F_VEC;
+			if (t->op == X_NUM)
+				return F_FOR;
+			break;
+		case S_NEXT:
+			if (st->n >= 'A' && st->n <= 'Z')
+				return F_NEXT;
+			break;
+	}
+	return F_NONE;
+}
+
+/***************************************************************************/
+/* What loop L may change: the variables in *vm and the arrays in *am, a
+ * bit each. Returns 0 if its statements aren't all ones ir_run() runs
+ * without leaving the program (no GOSUB, RETURN or END), 1 if they are,
+ * and 3 if as well its variable changes only at its own NEXT, so that
+ * the values it goes through are known when it starts.
+ */
+uchar ir_sets(L, vm, am)
+short int L;
+long *vm;
+long *am;
+{
+	struct cstmt *st;
+	struct cnode *t;
+	short int v = cmp_stmt[ir_lfor[L]].n;
+	short int i;
+	uchar ok = 3;
+
+	*vm = *am = 0;
+	for (i=ir_lfor[L]+1; i<=ir_lnext[L]; i++) {
+		st = cmp_stmt + i;
+		if (!ir_can[i])
+			return 0;
+		switch (st->op) {
+			case S_LET:
+				t = cmp_node + st->a;
+				if (t->op == X_VAR) {
+					*vm |= 1L << t->n;
+					if (t->n == v)
+						ok = 1;
+				}
+				else
+					*am |= 1L << t->n;
+				break;
+			case S_FOR:
+				*vm |= 1L << st->n;
+				if (st->n == v)
+					ok = 1;
+				break;
+			case S_NEXT:
+				if (st->n < 'A' || st->n > 'Z')
+					return 0;
+				*vm |= 1L << (st->n - 'A');
+				if (st->n - 'A' == v && i != ir_lnext[L])
+					ok = 1;
+				break;
+			case S_IF:
+			case S_GOTO:
+			case S_REM:
+			case S_PRINT:
+				break;
+			default:
+				return 0;
+		}
+	}
+	return ok;
+}
+
+/* Find the FOR loops: the statements after each FOR up to the first NEXT
+ * of its variable. The d of a FOR, and of the NEXT ending it, is the
+ * loop's number. Loops that overlap without one being inside the other
+ * are left alone.
+ */
+voidret ir_loopscan()
+{
+	struct cstmt *st;
+	short int in[IR_LOOPS];   /* the loops statement i is in, innermost last */
+	short int depth = 0;
+	short int i, e, L;
+	long vm, am;
+
+	ir_loops = 0;
+	for (i=0; i<cmp_stmts; i++)
+		if (cmp_stmt[i].op == S_FOR || cmp_stmt[i].op == S_NEXT)
+			cmp_stmt[i].d = -1;
+	for (i=0; i<cmp_stmts; i++) {
+		while (depth && i > ir_lnext[in[depth-1]])
+			depth--;
+		st = cmp_stmt + i;
+		if (st->op != S_FOR || ir_loops == IR_LOOPS)
+			continue;
+		for (e=i+1; e<cmp_stmts; e++)
+			if (cmp_stmt[e].op == S_NEXT && cmp_stmt[e].n == 'A' + st->n)
+				break;
+		if (e == cmp_stmts)
+			continue;
+		L = ir_loops++;
+		ir_lfor[L] = i;
+		ir_lnext[L] = e;
+		ir_lup[L] = depth ? in[depth-1] : -1;
+		ir_lok[L] = ir_sets(L, &vm, &am);
+		st->d = L;
+		if (cmp_stmt[e].d >= 0)
+			ir_lok[L] = ir_lok[cmp_stmt[e].d] = 0;   /* two loops, one NEXT */
+		else
+			cmp_stmt[e].d = L;
+		if (depth && e > ir_lnext[in[depth-1]])
+			for (ir_lok[L] = 0; depth > 0; depth--)
+				ir_lok[in[depth-1]] = 0;
+		in[depth++] = L;
+	}
+}
+
+/* 1 if x has the same value every time round a loop that changes the
+ * variables vm and arrays am
+ */
+uchar ir_invariant(x, vm, am)
+short int x;
+long vm;
+long am;
+{
+	struct cnode *n;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_STR:
+				return 1;
+			case X_VAR:
+				return !(vm >> n->n & 1);
+			case X_ELEM:
+				if (am >> n->n & 1)
+					return 0;
+				break;
+			case X_FUNC:
+				if (!ir_const_fn(n->n))
+					return 0;
+				break;
+		}
+		if (!ir_invariant(n->a, vm, am))
+			return 0;
+		x = n->b;
+	}
+	return 1;
+}
+
+/* Turn the largest parts of x that loop L doesn't change into X_HOIST
+ * nodes, the part itself moving to a new node.
+ */
+voidret ir_hoist(x, L, vm, am)
+short int x;
+short int L;
+long vm;
+long am;
+{
+	struct cnode *n, *h;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_VAR:
+			case X_STR:
+				return 0;
+			case X_ARG:
+				ir_hoist(n->a, L, vm, am);
+				x = n->b;
+				continue;
+		}
+		if (ir_invariant(x, vm, am)) {
+			if (ir_hoists == IR_HOIST || cmp_nodes == CMP_NODES)
+				return 0;
+			h = cmp_node + cmp_nodes;
+			h->op = n->op;
+			h->n = n->n;
+			h->val = n->val;
+			h->a = n->a;
+			h->b = n->b;
+			n->op = X_HOIST;
+			n->n = L;
+			n->val = ir_hoists;
+			n->a = cmp_nodes++;
+			n->b = -1;
+			ir_hnode[ir_hoists++] = x;
+			return 0;
+		}
+		ir_hoist(n->a, L, vm, am);
+		x = n->b;
+	}
+}
+
+/* Hand the bounds checks of the elements x reads or sets at I+c, I being
+ * the variable of loop L or of a loop L is in, to that loop
+ */
+voidret ir_bcheck(x, L)
+short int x;
+short int L;
+{
+	struct cnode *n;
+	short int m;
+	long c;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_VAR:
+			case X_STR:
+				return 0;
+			case X_ELEM:
+				if (n->b >= 0 || ir_checks == IR_CHECKS)
+					break;
+				for (m=L; m >= 0; m = ir_lup[m])
+					if (ir_lok[m] == 3 && ir_affine(n->a, cmp_stmt[ir_lfor[m]].n, &c)) {
+						n->val = m + 1;
+						ir_bnode[ir_checks++] = x;
+						break;
+					}
+				break;
+		}
+		ir_bcheck(n->a, L);
+		x = n->b;
+	}
+}
+
+/* 1 if going from statement s to k may leave a loop */
+uchar ir_leaves(s, k)
+short int s;
+short int k;
+{
+	short int L;
+
+	for (L=0; L<ir_loops; L++)
+		if (ir_lfor[L] < s && s <= ir_lnext[L] && (k <= ir_lfor[L] || k > ir_lnext[L]))
+			return 1;
+	return 0;
+}
+
+/* Move what doesn't change out of the loops, and hand them the bounds
+ * checks they can do once for all the times round
+ */
+voidret ir_loops_opt()
+{
+	struct cstmt *st;
+	struct cnode *t;
+	short int L, i, k, r[3];
+	long vm, am;
+
+	ir_loopscan();
+	ir_hoists = ir_checks = 0;
+	for (L=0; L<ir_loops; L++) {
+		ir_lh[L] = ir_hoists;
+		ir_on[L] = ir_inb[L] = 0;
+		if (!ir_lok[L])
+			continue;
+		ir_sets(L, &vm, &am);
+		for (i=ir_lfor[L]+1; i<=ir_lnext[L]; i++) {
+			st = cmp_stmt + i;
+			ir_roots(st, r);
+			if (st->op == S_LET && cmp_node[st->a].op == X_ELEM) {
+				/* the element set, not its value */
+				t = cmp_node + st->a;
+				ir_hoist(t->a, L, vm, am);
+				ir_hoist(t->b, L, vm, am);
+				ir_hoist(st->b, L, vm, am);
+			}
+			else if (st->op != S_LET)
+				for (k=0; k<3; k++)
+					ir_hoist(r[k], L, vm, am);
+			else
+				ir_hoist(st->b, L, vm, am);
+			for (k=0; k<3; k++)
+				ir_bcheck(r[k], L);
+			/* the statements of a loop inside this one are its own */
+			if (st->op == S_FOR && st->d >= 0 && ir_lup[st->d] == L)
+				i = ir_lnext[st->d];
+		}
+	}
+	ir_lh[ir_loops] = ir_hoists;
+	ir_any = 0;
+
+	for (i=0; i<cmp_stmts; i++) {
+		st = cmp_stmt + i;
+		ir_exit[i] = 0;
+		if (st->op == S_IF)
+			ir_exit[i] = ir_leaves(i, st->next_line);
+		if (st->op == S_GOTO)
+			ir_exit[i] = ir_leaves(i, st->target);
+	}
+}
+
+/* Fold the constants, then drop what constant IFs make unreachable */
+voidret ir_optimize()
+{
+	struct cstmt *st;
+	short int before = ir_live();
+	short int i, r[3], k;
+
+	/* the operands of a node come before it, the cells of an argument
+	 * list before the function
+	 */
+	for (i=0; i<cmp_nodes; i++)
+		ir_fold(i);
+
+	for (i=0; i<cmp_stmts; i++) {
+		st = cmp_stmt + i;
+		if (st->op == S_IF && cmp_node[st->a].op == X_NUM) {
+			if (cmp_node[st->a].val == 0) {
+				st->op = S_GOTO;
+				st->target = st->next_line;
+				for (k=i+1; k<st->next_line; k++) {
+					cmp_stmt[k].op = S_REM;
+					cmp_stmt[k].a = cmp_stmt[k].b = cmp_stmt[k].c = -1;
+				}
+			}
+			else
+				st->op = S_REM;
+			st->a = -1;
+		}
+		/* a GOTO to an expression of constants */
+		if ((st->op == S_GOTO || st->op == S_GOSUB) && st->target < 0
+				&& cmp_node[st->a].op == X_NUM) {
+			linenum = cmp_node[st->a].val;
+			st->target = c_findstmt(findline() - pgm_start);
+		}
+	}
+	ir_removed = before - ir_live();
+
+	for (i=0; i<cmp_stmts; i++) {
+		st = cmp_stmt + i;
+		ir_roots(st, r);
+		switch (st->op) {
+			case S_PRINT:
+				ir_can[i] = st->a < 0;
+				k = 0;
+				for (r[0]=st->b; r[0] >= 0; r[0] = cmp_node[r[0]].b)
+					if (cmp_node[cmp_node[r[0]].a].op != X_STR) {
+						ir_can[i] &= ir_pure(cmp_node[r[0]].a);
+						k++;
+					}
+				if (k > IR_ITEMS)
+					ir_can[i] = 0;
+				continue;
+			case S_LET:
+			case S_IF:
+			case S_GOTO:
+			case S_GOSUB:
+			case S_RETURN:
+			case S_FOR:
+			case S_NEXT:
+			case S_REM:
+			case S_END:
+				ir_can[i] = ir_pure(r[0]) && ir_pure(r[1]) && ir_pure(r[2]);
+				continue;
+		}
+		ir_can[i] = 0;
+	}
+	ir_loops_opt();
+	for (i=0; i<cmp_stmts; i++)
+		ir_fuse[i] = ir_can[i] ? ir_super(i) : F_NONE;
+	for (i=0; i<F_KINDS; i++)
+		ir_fired[i] = 0;
+	ir_shown = 0;
+	for (i=0; i<26; i++)
+		ir_head_line[i] = 0;
+}
+
+/* The program in cmp_stmt[], optimized, if it fits. Returns 1 if it is
+ * there.
+ */
+uchar ir_compile()
+{
+	uchar *t = txtpos;
+
+	ir_vars = (short int *)variables_table;
+	if (ir_prog == 0) {
+		ir_prog = compile() < 0 ? 2 : 1;
+		if (ir_prog == 1)
+			ir_optimize();
+	}
+	txtpos = t;
+	return ir_prog == 1;
+}
+
+/* the program has changed: compile it again when it is next needed */
+voidret ir_reset()
+{
+	ir_prog = 0;
+}
+
+/* what the optimizer did, for -v */
+voidret ir_report()
+{
+	if (ir_prog != 1)
+		return 0;
+	printnum(ir_removed);
+	printmsg(" nodes removed by the optimizer");
+	printnum(ir_hoists);
+	printmsg(" values hoisted out of loops");
+	printnum(ir_checks);
+	printmsg(" bounds checks done once per loop");
+}
+
+/* n, which may not fit in an int */
+voidret ir_putlong(n)
+long n;
+{
+	if (n >= 10)
+		ir_putlong(n / 10);
+	putch('0' + (int)(n % 10));
+}
+
+/* how often each superinstruction ran, for -v at the end of a run */
+voidret ir_counts()
+{
+	short int i;
+
+	if (ir_prog != 1 || ir_shown)
+		return 0;
+	ir_shown = 1;
+	for (i=1; i<F_KINDS; i++) {
+		ir_putlong(ir_fired[i]);
+		putch(' ');
+		printmsg(ir_fnames[i]);
+	}
+}
+
+/***************************************************************************/
+short int ir_eval();
+
+/* the element number of the X_ELEM node n, as arr_index() */
+unsigned int ir_index(n)
+struct cnode *n;
+{
+	unsigned int siz, cols;
+	unsigned int i, j;
+
+	i = ir_eval(n->a);
+	if (n->val && ir_inb[n->val - 1])
+		return i;   /* checked when the loop started */
+	siz = ((short int *)array_sz)[n->n];
+	cols = ((short int *)array_cols)[n->n];
+	if (n->b >= 0) {
+		j = ir_eval(n->b);
+		if (cols == 0 || i >= siz/cols || j >= cols)
+			ir_err = 1;
+		return i*cols + j;
+	}
+	if (i >= siz)
+		ir_err = 1;
+	return i;
+}
+
+/* the value of node x, which ir_pure() has passed */
+short int ir_eval(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+	short int a, b;
+	unsigned int i;
+
+	switch (n->op) {
+		case X_NUM:
+			return n->val;
+		case X_VAR:
+			return ir_vars[n->n];
+		case X_ELEM:
+			i = ir_index(n);
+			if (ir_err)
+				return 0;
+			return elem_get(n->n, i);
+		case X_FUNC:
+			if (n->n == FUNC_FRE)
+				return ir_func(FUNC_FRE, 0, 0);
+			a = ir_eval(cmp_node[n->a].a);
+			b = ONE_Q14;
+			if (cmp_node[n->a].b >= 0)
+				b = ir_eval(cmp_node[cmp_node[n->a].b].a);
+			return ir_func(n->n, a, b);
+		case X_NOT:
+			return ~ir_eval(n->a);
+		case X_HOIST:
+			if (ir_on[n->n & 0xFF] && ir_hok[n->val])
+				return ir_hval[n->val];
+			return ir_eval(n->a);
+	}
+	a = ir_eval(n->a);
+	b = ir_eval(n->b);
+	return ir_op(n->op, a, b);
+}
+
+/* A GOTO from statement s to statement k. If it goes back it may
+ * close a hot loop, see jit.c: returns what jit_goto() does.
+ */
+uchar ir_goto(s, k)
+short int s;
+short int k;
+{
+	if (no_jit || k > s || k >= cmp_stmts)
+		return JIT_NO;
+	return jit_goto(pgm_start + cmp_stmt[s].line, pgm_start + cmp_stmt[k].line);
+}
+
+/* 1 if the elements of arrays x reads, or sets, with the loop variable
+ * v going from lo to hi are all in bounds
+ */
+uchar ir_vbounds(x, v, lo, hi)
+short int x;
+short int v;
+long lo;
+long hi;
+{
+	struct cnode *n;
+	long c;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_VAR:
+			case X_STR:
+				return 1;
+			case X_ELEM:
+				if (n->b < 0 && ir_affine(n->a, v, &c))
+					return lo + c >= 0
+						&& hi + c < (unsigned short)((short int *)array_sz)[n->n];
+				break;
+		}
+		if (!ir_vbounds(n->a, v, lo, hi))
+			return 0;
+		x = n->b;
+	}
+	return 1;
+}
+
+/* x for n times round the loop of variable v, starting from i and going
+ * up by step, into out[]
+ */
+voidret ir_vecx(x, v, i, step, n, out)
+short int x;
+short int v;
+short int i;
+short int step;
+short int n;
+short int *out;
+{
+	struct cnode *e = cmp_node + x;
+	short int l[IR_VEC];
+	short int r[IR_VEC];
+	short int k;
+	long c;
+	uchar *p;
+
+	switch (e->op) {
+		case X_NUM:
+		case X_VAR:
+			if (e->op == X_VAR && e->n == v)
+				for (k=0; k<n; k++, i += step)
+					out[k] = i;
+			else {
+				l[0] = e->op == X_NUM ? e->val : ((short int *)variables_table)[e->n];
+				for (k=0; k<n; k++)
+					out[k] = l[0];
+			}
+			return 0;
+		case X_ELEM:
+			if (e->b < 0 && ir_affine(e->a, v, &c)) {
+				/* in bounds, see ir_vbounds() */
+				p = (uchar *)arrptr(e->n);
+				c += i;
+				if (((short int *)array_esz)[e->n] == 1)
+					for (k=0; k<n; k++, c += step)
+						out[k] = p[c] & 0xFF;
+				else
+					for (k=0; k<n; k++, c += step)
+						out[k] = ((short int *)p)[c];
+				return 0;
+			}
+			l[0] = ir_eval(x);
+			for (k=0; k<n; k++)
+				out[k] = l[0];
+			return 0;
+		case X_FUNC:
+			ir_vecx(cmp_node[e->a].a, v, i, step, n, l);
+			if (cmp_node[e->a].b >= 0)
+				ir_vecx(cmp_node[cmp_node[e->a].b].a, v, i, step, n, r);
+			else
+				for (k=0; k<n; k++)
+					r[k] = ONE_Q14;
+			for (k=0; k<n; k++)
+				out[k] = ir_func(e->n, l[k], r[k]);
+			return 0;
+		case X_NOT:
+			ir_vecx(e->a, v, i, step, n, out);
+			for (k=0; k<n; k++)
+				out[k] = ~out[k];
+			return 0;
+		case X_HOIST:
+			ir_vecx(e->a, v, i, step, n, out);
+			return 0;
+	}
+	ir_vecx(e->a, v, i, step, n, l);
+	ir_vecx(e->b, v, i, step, n, r);
+	switch (e->op) {
+		case X_ADD:
+			for (k=0; k<n; k++)
+				out[k] = l[k] + r[k];
+			return 0;
+		case X_SUB:
+			for (k=0; k<n; k++)
+				out[k] = l[k] - r[k];
+			return 0;
+		case X_MUL:
+			for (k=0; k<n; k++)
+				out[k] = l[k] * r[k];
+			return 0;
+		case X_AND:
+			for (k=0; k<n; k++)
+				out[k] = l[k] & r[k];
+			return 0;
+		case X_OR:
+			for (k=0; k<n; k++)
+				out[k] = l[k] | r[k];
+			return 0;
+	}
+	for (k=0; k<n; k++)
+		out[k] = ir_op(e->op, l[k], r[k]);
+}
+
+/* Run the loop of the vectorizable FOR statement s, from a to b by step
+ * c. Returns 1 if it has run the whole loop, or 0 with *from set to the
+ * value of the variable to carry on from, the times round before it
+ * having been run.
+ */
+uchar ir_vector(s, a, b, c, from)
+short int s;
+short int a;
+short int b;
+short int c;
+short int *from;
+{
+	struct cstmt *st = cmp_stmt + s;
+	struct cnode *t = cmp_node + st[1].a;
+	short int out[IR_VEC];
+	short int m, k;
+	long n, last, off, i;
+	uchar *p;
+
+	*from = a;
+
+	/* the body runs at least once, as in the interpreter */
+	if (c > 0 && a <= b)
+		n = ((long)b - a) / c + 1;
+	else if (c < 0 && a >= b)
+		n = ((long)a - b) / -(long)c + 1;
+	else
+		n = 1;
+	last = a + (n-1)*c;
+	if (last + c < -32768 || last + c > 32767)
+		return 0;   /* the variable would wrap and go round again */
+	if (c < 0) {
+		i = last;
+		last = a;
+	}
+	else
+		i = a;
+	if (!ir_vbounds(st[1].a, st->n, i, last) || !ir_vbounds(st[1].b, st->n, i, last))
+		return 0;
+
+	ir_affine(t->a, st->n, &off);
+	p = (uchar *)arrptr(t->n);
+	for (; n > 0; n -= m) {
+		m = n < IR_VEC ? n : IR_VEC;
+		ir_err = 0;
+		ir_vecx(st[1].b, st->n, *from, c, m, out);
+		if (ir_err)
+			return 0;
+		i = *from + off;
+		if (((short int *)array_esz)[t->n] == 1)
+			for (k=0; k<m; k++, i += c)
+				p[i] = out[k];
+		else
+			for (k=0; k<m; k++, i += c)
+				((short int *)p)[i] = out[k];
+		*from += m*c;
+	}
+	((short int *)variables_table)[st->n] = *from;
+	return 1;
+}
+
+/* Loop L starts, or goes round again, with its variable at i, to end at b
+ * going up by c: work out its hoisted values, and whether the elements
+ * it accesses are all in bounds for the rest of the loop.
+ */
+voidret ir_enter(L, i, b, c)
+short int L;
+short int i;
+short int b;
+short int c;
+{
+	struct cnode *n;
+	long lo = i, hi = i;
+	long d;
+	short int k;
+
+	ir_on[L] = ir_any = 1;
+	if (c > 0 && b > i)
+		hi = b;
+	if (c < 0 && b < i)
+		lo = b;
+	/* the variable mustn't wrap and go round again */
+	ir_inb[L] = (long)b + c >= -32768 && (long)b + c <= 32767;
+	for (k=0; k<ir_checks && ir_inb[L]; k++) {
+		n = cmp_node + ir_bnode[k];
+		if (n->val != L + 1)
+			continue;
+		ir_affine(n->a, cmp_stmt[ir_lfor[L]].n, &d);
+		if (lo + d < 0 || hi + d >= (unsigned short)((short int *)array_sz)[n->n])
+			ir_inb[L] = 0;
+	}
+	for (k=ir_lh[L]; k<ir_lh[L+1]; k++) {
+		ir_err = 0;
+		ir_hval[k] = ir_eval(cmp_node[ir_hnode[k]].a);
+		ir_hok[k] = !ir_err;
+	}
+	ir_err = 0;
+}
+
+/* control has left the loops, or may have */
+voidret ir_leave()
+{
+	short int L;
+
+	if (!ir_any)
+		return 0;
+	for (L=0; L<ir_loops; L++)
+		ir_on[L] = ir_inb[L] = 0;
+	ir_any = 0;
+}
+
+/* the first statement of the line after the one at line */
+short int ir_after(line)
+uchar *line;
+{
+	return cmp_stmt[c_findstmt(line - pgm_start)].next_line;
+}
+
+/* Run the program from statement s. Sets up loop() to carry on and
+ * returns what it is to do, as for jit_loop().
+ */
+uchar ir_run(s)
+short int s;
+{
+	struct cstmt *st;
+	struct cnode *t;
+	short int *vars = (short int *)variables_table;
+	short int v[IR_ITEMS];
+	short int a, b, c;
+	short int l, k;
+	unsigned int i;
+	short int span = IR_SPAN;
+	uchar *f;
+	uchar var;
+
+	while (s < cmp_stmts) {
+		st = cmp_stmt + s;
+		ir_at = s+1;
+		STAT(stat_stmts++);
+		if (!ir_can[s] || --span == 0)
+			goto stop;
+		ir_err = 0;
+		switch (ir_fuse[s]) {
+			case F_IFGOTO:
+				ir_fired[F_IFGOTO]++;
+				t = cmp_node + st->a;
+				a = vars[cmp_node[t->a].n];
+				b = cmp_node[t->b].val;
+				switch (t->op) {
+					case X_GE: a = a >= b; break;
+					case X_NE: a = a != b; break;
+					case X_GT: a = a > b; break;
+					case X_EQ: a = a == b; break;
+					case X_LE: a = a <= b; break;
+					case X_LT: a = a < b; break;
+				}
+				if (!a) {
+					if (ir_exit[s])
+						ir_leave();
+					s = st->next_line;
+					continue;
+				}
+				if (ir_exit[s+1])
+					ir_leave();
+				k = st[1].target;
+				l = ir_goto(s+1, k);
+				if (l != JIT_NO)
+					return l;
+				s = k;
+				continue;
+			case F_INC:
+				ir_fired[F_INC]++;
+				vars[cmp_node[st->a].n] += ir_k[s];
+				s++;
+				continue;
+		}
+		switch (st->op) {
+			case S_LET:
+				a = ir_eval(st->b);
+				t = cmp_node + st->a;
+				if (t->op == X_VAR) {
+					if (ir_err)
+						goto stop;
+					vars[t->n] = a;
+				}
+				else {
+					i = ir_index(t);
+					if (ir_err)
+						goto stop;
+					elem_put(t->n, i, a);
+				}
+				s++;
+				break;
+			case S_IF:
+				a = ir_eval(st->a);
+				if (ir_err)
+					goto stop;
+				if (!a && ir_exit[s])
+					ir_leave();
+				s = a ? s+1 : st->next_line;
+				break;
+			case S_GOTO:
+			case S_GOSUB:
+				if (st->target >= 0)
+					k = st->target;
+				else {
+					linenum = ir_eval(st->a);
+					if (ir_err)
+						goto stop;
+					current_line = findline();
+					k = current_line == pgm_end ? cmp_stmts : c_findstmt(current_line - pgm_start);
+				}
+				if (st->op == S_GOSUB) {
+					if (sp + sizeof(struct stack_gosub_frame) < stack_limit)
+						goto stop;
+					sp -= sizeof(struct stack_gosub_frame);
+					STAT_PEAK();
+					((struct stack_gosub_frame *)sp)->frame_type = STACK_GOSUB_FLAG;
+					((struct stack_gosub_frame *)sp)->sgf_txtpos = pgm_start + st->end;
+					((struct stack_gosub_frame *)sp)->sgf_current_line = pgm_start + st->line;
+				}
+				else {
+					if (ir_exit[s])
+						ir_leave();
+					l = ir_goto(s, k);
+					if (l != JIT_NO)
+						return l;
+				}
+				s = k;
+				break;
+			case S_RETURN:
+				f = find_frame(0);
+				if (f == 0 || *f != STACK_GOSUB_FLAG
+						|| ((struct stack_gosub_frame *)f)->sgf_current_line == 0)
+					goto stop;
+				s = ir_after(((struct stack_gosub_frame *)f)->sgf_current_line);
+				sp += sizeof(struct stack_gosub_frame);
+				break;
+			case S_FOR:
+				if (ir_fuse[s] == F_FOR) {
+					ir_fired[F_FOR]++;
+					a = cmp_node[st->a].val;
+				}
+				else
+					a = ir_eval(st->a);
+				b = ir_eval(st->b);
+				c = st->c >= 0 ? ir_eval(st->c) : 1;
+				if (ir_err || sp + sizeof(struct stack_for_frame) < stack_limit)
+					goto stop;
+				if (ir_fuse[s] == F_VEC && ir_vector(s, a, b, c, &a)) {
+					ir_fired[F_VEC]++;
+					s += 3;   /* past the NEXT */
+					break;
+				}
+				sp -= sizeof(struct stack_for_frame);
+				STAT_PEAK();
+				vars[st->n] = a;
+				{
+					struct stack_for_frame *fr = (struct stack_for_frame *)sp;
+
+					fr->frame_type = STACK_FOR_FLAG;
+					fr->for_var = 'A' + st->n;
+					fr->terminal = b;
+					fr->step = c;
+					fr->sff_txtpos = pgm_start + st->end;
+					fr->sff_current_line = pgm_start + st->line;
+				}
+				ir_head_line[st->n] = pgm_start + st->line;
+				ir_head[st->n] = s+1;
+				if (st->d >= 0 && ir_lok[st->d])
+					ir_enter(st->d, a, b, c);
+				s++;
+				break;
+			case S_NEXT:
+				var = st->n;
+				if (var < 'A' || var > 'Z')
+					goto stop;
+				f = sp;
+				if (ir_fuse[s] == F_NEXT && *f == STACK_FOR_FLAG
+						&& ((struct stack_for_frame *)f)->for_var == var)
+					ir_fired[F_NEXT]++;
+				else
+					f = find_frame(var);
+				if (f == 0 || *f != STACK_FOR_FLAG)
+					goto stop;
+				{
+					struct stack_for_frame *fr = (struct stack_for_frame *)f;
+					short int *p = vars + var - 'A';
+
+					if (fr->sff_current_line == 0)
+						goto stop;
+					*p += fr->step;
+					if (fr->step > 0 && *p <= fr->terminal || fr->step < 0 && *p >= fr->terminal) {
+						sp = f;
+						if (!no_jit) {
+							l = jit_loop(f);
+							if (l != JIT_NO)
+								return l;
+						}
+						if (ir_head_line[var-'A'] != fr->sff_current_line) {
+							ir_head_line[var-'A'] = fr->sff_current_line;
+							ir_head[var-'A'] = ir_after(fr->sff_current_line);
+						}
+						s = ir_head[var-'A'];
+						l = cmp_stmt[s-1].op == S_FOR ? cmp_stmt[s-1].d : -1;
+						if (l != st->d)
+							ir_leave();
+						if (l >= 0 && ir_lok[l] && !ir_on[l])
+							ir_enter(l, *p, fr->terminal, fr->step);
+					}
+					else {
+						sp = f + sizeof(struct stack_for_frame);
+						if (st->d >= 0)
+							ir_on[st->d] = ir_inb[st->d] = 0;
+						else
+							ir_leave();
+						s++;
+					}
+				}
+				break;
+			case S_REM:
+				s++;
+				break;
+			case S_END:
+				s = cmp_stmts;
+				break;
+			case S_PRINT:
+				k = 0;
+				for (l=st->b; l >= 0; l = cmp_node[l].b)
+					if (cmp_node[cmp_node[l].a].op != X_STR)
+						v[k++] = ir_eval(cmp_node[l].a);
+				if (ir_err)
+					goto stop;
+				k = 0;
+				for (l=st->b; l >= 0; l = cmp_node[l].b) {
+					t = cmp_node + cmp_node[l].a;
+					if (t->op == X_STR)
+						for (i=0; i<t->a; i++)
+							putch(pgm_start[t->val + i]);
+					else
+						printnum(v[k++]);
+				}
+				if (!st->n)
+					put_nl();
+				s++;
+				break;
+		}
+	}
+	current_line = pgm_end;
+	return JIT_LINE;
+
+stop:
+	current_line = pgm_start + st->line;
+	txtpos = pgm_start + st->txt;
+	return JIT_STMT;
+}
+
+/* Run the program from the start of line as far as ir_run() can.
+ * Returns JIT_NO if it can't run the program at all.
+ */
+uchar ir_line(line)
+uchar *line;
+{
+	uchar k;
+
+	if (!ir_compile())
+		return JIT_NO;
+	ir_leave();
+	k = ir_run(c_findstmt(line - pgm_start));
+	ir_at = 0;
+	return k;
+}
+
+/***************************************************************************/
+/* PARFOR */
+
+struct pf_worker {
+	short int vars[26];    /* its own copy of the variables */
+	long first;            /* it runs iterations first on */
+	long count;            /* this many of them */
+	long fail;             /* the one that went wrong, or -1 */
+	short int at;          /* at this statement */
+};
+
+struct pf_worker ir_pf[PAR_MAX];
+short int ir_pfs, ir_pfe;      /* the PARFOR running, and its NEXT */
+short int ir_pfa, ir_pfc;      /* its start and step */
+
+/* the variables x reads, a bit each */
+long ir_vmask(x)
+short int x;
+{
+	long m = 0;
+
+	while (x >= 0) {
+		switch (cmp_node[x].op) {
+			case X_NUM:
+			case X_STR:
+				return m;
+			case X_VAR:
+				return m | 1L << cmp_node[x].n;
+		}
+		m |= ir_vmask(cmp_node[x].a);
+		x = cmp_node[x].b;
+	}
+	return m;
+}
+
+/* Check the body of the PARFOR statement s, up to the NEXT of its
+ * variable, which goes in *e. It may hold only LET, IF and REM, with
+ * expressions ir_eval() can work out. The arrays are shared by all the
+ * iterations; a variable other than the loop's own may be set only if
+ * it is set before it is read, and not after an IF, so that each
+ * iteration has a copy of its own. Returns PF_*.
+ */
+uchar ir_pfcheck(s, e)
+short int s;
+short int *e;
+{
+	struct cstmt *st = cmp_stmt + s;
+	struct cnode *t;
+	short int v = st->n;
+	short int k, cond = s+1;   /* statements before cond are after an IF */
+	long own = 0, seen = 0, bit;
+
+	for (*e=s+1; *e<cmp_stmts; (*e)++)
+		if (cmp_stmt[*e].op == S_NEXT && cmp_stmt[*e].n == 'A' + v)
+			break;
+	if (*e == cmp_stmts)
+		return PF_SERIAL;
+	for (k=s+1; k<*e; k++) {
+		st = cmp_stmt + k;
+		switch (st->op) {
+			case S_REM:
+				break;
+			case S_IF:
+				if (!ir_pure(st->a) || st->next_line > *e)
+					return PF_BODY;
+				seen |= ir_vmask(st->a);
+				if (cond < st->next_line)
+					cond = st->next_line;
+				break;
+			case S_LET:
+				if (!ir_pure(st->a) || !ir_pure(st->b))
+					return PF_BODY;
+				t = cmp_node + st->a;
+				seen |= ir_vmask(st->b);
+				if (t->op == X_ELEM) {
+					seen |= ir_vmask(t->a) | ir_vmask(t->b);
+					break;
+				}
+				bit = 1L << t->n;
+				if (t->n == v)
+					return PF_SHARED;
+				if (!(own & bit)) {
+					if (k < cond || (seen & bit))
+						return PF_SHARED;
+					own |= bit;
+				}
+				break;
+			default:
+				return PF_BODY;
+		}
+	}
+	return PF_OK;
+}
+
+/* Run worker w's iterations of the PARFOR, stopping at the first that
+ * goes wrong
+ */
+voidret ir_pfwork(w)
+int w;
+{
+	struct pf_worker *pw = ir_pf + w;
+	struct cstmt *st;
+	struct cnode *t;
+	short int var = cmp_stmt[ir_pfs].n;
+	short int s, a;
+	unsigned int i;
+	long k;
+
+	ir_vars = pw->vars;
+	pw->fail = -1;
+	for (k=pw->first; k < pw->first + pw->count; k++) {
+		pw->vars[var] = ir_pfa + k*ir_pfc;
+		for (s=ir_pfs+1; s<ir_pfe; ) {
+			st = cmp_stmt + s;
+			ir_err = 0;
+			switch (st->op) {
+				case S_LET:
+					a = ir_eval(st->b);
+					t = cmp_node + st->a;
+					if (t->op == X_VAR) {
+						if (ir_err)
+							goto fail;
+						pw->vars[t->n] = a;
+					}
+					else {
+						i = ir_index(t);
+						if (ir_err)
+							goto fail;
+						elem_put(t->n, i, a);
+					}
+					s++;
+					break;
+				case S_IF:
+					a = ir_eval(st->a);
+					if (ir_err)
+						goto fail;
+					s = a ? s+1 : st->next_line;
+					break;
+				default:
+					s++;
+					break;
+			}
+		}
+	}
+	return 0;
+
+fail:
+	pw->fail = k;
+	pw->at = s;
+}
+
+/* The PARFOR that ends current_line, from a to b by c: split its
+ * iterations between workers, one for each processor, and run them. A
+ * worker sets the arrays and its own copy of the variables; afterwards
+ * the variables are those of the last iteration, as after a FOR. If an
+ * iteration went wrong, the earliest such is left for the interpreter to
+ * run into, as if the loop had been a FOR; later ones may already have
+ * run. Returns what loop() is to do, JIT_*, JIT_NO to run it as a FOR.
+ */
+uchar ir_parfor(v, a, b, c)
+short int v;
+short int a;
+short int b;
+short int c;
+{
+	struct cstmt *st;
+	struct pf_worker *pw;
+	long n, last;
+	short int s, e, w, k, i;
+
+	if (!ir_compile())
+		return JIT_NO;
+	s = ir_after(current_line) - 1;
+	st = cmp_stmt + s;
+	if (st->op != S_PARFOR || st->n != v)
+		return JIT_NO;
+	switch (ir_pfcheck(s, &e)) {
+		case PF_SERIAL:
+			return JIT_NO;
+		case PF_SHARED:
+			return JIT_SHARED;
+		case PF_BODY:
+			return JIT_PARBODY;
+	}
+
+	/* the body runs at least once, as in the interpreter */
+	if (c > 0 && a <= b)
+		n = ((long)b - a) / c + 1;
+	else if (c < 0 && a >= b)
+		n = ((long)a - b) / -(long)c + 1;
+	else
+		n = 1;
+	last = a + (n-1)*c;
+	if (last + c < -32768 || last + c > 32767)
+		return JIT_NO;   /* the variable would wrap and go round again */
+	if (sp + sizeof(struct stack_for_frame) < stack_limit)
+		return JIT_NO;
+
+	w = host_cpus();
+	if (w > PAR_MAX)
+		w = PAR_MAX;
+	if (w > n)
+		w = n;
+	for (k=0; k<w; k++) {
+		pw = ir_pf + k;
+		pw->first = k ? pw[-1].first + pw[-1].count : 0;
+		pw->count = n / w + (k < n % w);
+		for (i=0; i<26; i++)
+			pw->vars[i] = ((short int *)variables_table)[i];
+	}
+	ir_pfs = s;
+	ir_pfe = e;
+	ir_pfa = a;
+	ir_pfc = c;
+	host_parallel(ir_pfwork, w);
+	ir_vars = (short int *)variables_table;
+
+	for (k=0; k<w-1 && ir_pf[k].fail < 0; k++)
+		;
+	pw = ir_pf + k;
+	for (i=0; i<26; i++)
+		((short int *)variables_table)[i] = pw->vars[i];
+	if (pw->fail >= 0) {
+		struct stack_for_frame *fr;
+
+		sp -= sizeof(struct stack_for_frame);
+		STAT_PEAK();
+		fr = (struct stack_for_frame *)sp;
+		fr->frame_type = STACK_FOR_FLAG;
+		fr->for_var = 'A' + v;
+		fr->terminal = b;
+		fr->step = c;
+		fr->sff_txtpos = pgm_start + st->end;
+		fr->sff_current_line = pgm_start + st->line;
+		current_line = pgm_start + cmp_stmt[pw->at].line;
+		txtpos = pgm_start + cmp_stmt[pw->at].txt;
+		return JIT_STMT;
+	}
+	((short int *)variables_table)[v] = last + c;
+	current_line = pgm_start + cmp_stmt[e].line;
+	txtpos = pgm_start + cmp_stmt[e].end;
+	return JIT_NEXT;
+}
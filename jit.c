@@ -0,0 +1,751 @@
+/*  jit.c : runs hot loops as x86-64 machine code
+
+ loop() counts, per line, how often each FOR loop goes round and how
+ often each backward GOTO is taken. Once one of them has gone round
+ JIT_HOT times its statements are taken from the optimized compiled
+ form of the program (see ir.c and tbasic.h), turned into machine
+ code in an executable buffer, and from then on run there, with the
+ variables the loop uses kept in registers.
+
+ A FOR loop runs from the line after the FOR to the NEXT of its
+ variable, a GOTO loop from the line the GOTO goes to down to the line
+ it is on. Only LET, IF, GOTO to a constant line and the NEXT closing
+ the loop are turned into machine code, with expressions made of
+ variables, constants, one-dimensional arrays, arithmetic, comparisons,
+ logic and ABS().
+
+ Anything else makes the machine code give up (deoptimize): another
+ statement, a jump out of the loop, or an expression that goes wrong,
+ such as a division by zero or an index out of bounds. It writes the
+ variables back and hands loop() the statement to carry on at, which
+ the interpreter then runs as if the machine code had never been there,
+ error messages and all. A loop also hands back every JIT_SPAN times
+ round so that loop() can look for the break key. Editing the program,
+ DIM and CLEAR throw all the machine code away.
+
+ Linux on x86-64 only; elsewhere jit_loop() and jit_goto() never
+ compile anything.
+*/
+
+#include <stdio.h>
+#include "host.h"
+#include "tbasic.h"
+
+#ifdef LINUX
+#ifdef __x86_64__
+#define JIT
+#endif
+#endif
+
+uchar *jit_line;   /* the line of the loop running as machine code, or 0 */
+
+#ifdef JIT
+#include <sys/mman.h>
+
+#define JIT_SLOTS 64       /* loops being counted, hashed by line */
+#define JIT_HOT   64       /* times round before a loop is compiled */
+#define JIT_SPAN  65536    /* times round between looks at the break key */
+#define JIT_CODE  262144   /* bytes of machine code */
+#define JIT_FIX   4096     /* jumps in a loop */
+#define JIT_REGS  8
+
+/* a loop: its line offset from pgm_start*2 + 1 for a GOTO loop, +1 */
+struct jit_slot {
+	unsigned short tag;
+	unsigned short hits;
+	uchar *code;
+	uchar failed;
+};
+
+/* jumps waiting for the address they go to */
+#define J_STMT 0   /* the code of statement val */
+#define J_EXIT 1   /* hand loop() val: statement*2, +1 for after a NEXT */
+#define J_EPI  2   /* the epilogue, with the code to hand back in eax */
+
+struct jit_fix {
+	uchar *at;
+	uchar kind;
+	short int val;
+};
+
+struct jit_slot jit_slots[JIT_SLOTS];
+struct jit_fix jit_fix[JIT_FIX];
+short int jit_nfix;
+uchar *jit_lab[CMP_STMTS];   /* code of each statement of the loop */
+char jit_reg[26];            /* register of each variable, -1 for memory */
+uchar jit_regs[JIT_REGS] = { 3, 12, 13, 14, 15, 8, 9, 10 };  /* rbx, r12-r15, r8-r10 */
+uchar *jit_buf;              /* the code buffer, writable only in jit_build() */
+uchar jit_dead;              /* the buffer couldn't be made executable again */
+uchar *jc;                   /* where code is going */
+uchar jit_full;
+short int jit_head, jit_end; /* the statements of the loop */
+short int jit_cur;           /* the statement being compiled */
+
+extern uchar *current_line;
+extern uchar *txtpos;
+
+/***************************************************************************/
+voidret jb(b)
+int b;
+{
+	if (jc < jit_buf + JIT_CODE)
+		*jc++ = b;
+	else
+		jit_full = 1;
+}
+
+/* a 32-bit value */
+voidret jw(w)
+long w;
+{
+	jb(w);
+	jb(w >> 8);
+	jb(w >> 16);
+	jb(w >> 24);
+}
+
+voidret jq(q)
+long q;
+{
+	jw(q);
+	jw(q >> 32);
+}
+
+/* a jump, cc -1 for jmp, to be filled in later */
+voidret jjump(cc, kind, val)
+int cc;
+int kind;
+int val;
+{
+	if (cc < 0)
+		jb(0xE9);
+	else {
+		jb(0x0F);
+		jb(0x80 | cc);
+	}
+	if (jit_nfix >= JIT_FIX) {
+		jit_full = 1;
+		return 0;
+	}
+	jit_fix[jit_nfix].at = jc;
+	jit_fix[jit_nfix].kind = kind;
+	jit_fix[jit_nfix].val = val;
+	jit_nfix++;
+	jw(0);
+}
+
+#define CC_E  4
+#define CC_AE 3
+#define CC_S  8
+#define CC_NE 5
+#define CC_L  0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G  0xF
+
+/* go to statement s: a jump within the loop, or hand it to loop() */
+voidret jgoto(cc, s)
+int cc;
+short int s;
+{
+	uchar *p;
+
+	if (s < jit_head || s > jit_end)
+		jjump(cc, J_EXIT, s*2);
+	else if (s > jit_cur)
+		jjump(cc, J_STMT, s);
+	else {
+		/* going round: now and then let loop() look at the break key */
+		p = jc;
+		if (cc >= 0) {
+			jb(0x70 | (cc ^ 1)); jb(0);     /* jncc over */
+		}
+		jb(0x41); jb(0xFF); jb(0xCB);      /* dec r11d */
+		jjump(CC_E, J_EXIT, s*2);
+		jjump(-1, J_STMT, s);
+		if (cc >= 0)
+			p[1] = jc - (p+2);
+	}
+}
+
+/* mov dst32, src32 */
+voidret jmov(dst, src)
+int dst;
+int src;
+{
+	if (dst >= 8 || src >= 8)
+		jb(0x40 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0));
+	jb(0x89);
+	jb(0xC0 | (src & 7) << 3 | (dst & 7));
+}
+
+/* variable v into eax (r 0) or ecx (r 1) */
+voidret jgetvar(r, v)
+int r;
+int v;
+{
+	if (jit_reg[v] >= 0)
+		jmov(r, jit_reg[v]);
+	else {
+		jb(0x0F); jb(0xBF); jb(0x47 | r << 3); jb(v*2);  /* movsx r, word [rdi+2v] */
+	}
+}
+
+/* eax into variable v */
+voidret jsetvar(v)
+int v;
+{
+	if (jit_reg[v] >= 0)
+		jmov(jit_reg[v], 0);
+	else {
+		jb(0x66); jb(0x89); jb(0x47); jb(v*2);  /* mov [rdi+2v], ax */
+	}
+}
+
+voidret jsext()
+{
+	jb(0x0F); jb(0xBF); jb(0xC0);   /* movsx eax, ax */
+}
+
+/* can node x be turned into machine code? */
+uchar jit_ok(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+
+	switch (n->op) {
+		case X_NUM:
+		case X_VAR:
+			return 1;
+		case X_ELEM:
+			return n->b < 0 && jit_ok(n->a);
+		case X_FUNC:
+			return n->n == FUNC_ABS && n->a >= 0 && cmp_node[n->a].b < 0
+				&& jit_ok(cmp_node[n->a].a);
+		case X_NOT:
+		case X_HOIST:
+			return jit_ok(n->a);
+		case X_NATIVE:
+		case X_ARG:
+		case X_STR:
+			return 0;
+		default:
+			return jit_ok(n->a) && jit_ok(n->b);
+	}
+}
+
+/* check index eax against array n and point rdx at it */
+voidret jelem(n)
+int n;
+{
+	jb(0x3D); jw((unsigned short)((short int *)array_sz)[n]);  /* cmp eax, size */
+	jjump(CC_AE, J_EXIT, jit_cur*2);
+	jb(0x48); jb(0xBA);                                        /* mov rdx, base */
+	jq((long)(memory + ((short int *)array_table)[n]));
+}
+
+voidret jexpr();
+
+/* the value of node x into eax */
+voidret jexpr(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+	struct cnode *b;
+
+	switch (n->op) {
+		case X_NUM:
+			if (n->val == 0) {
+				jb(0x31); jb(0xC0);   /* xor eax, eax */
+			}
+			else {
+				jb(0xB8); jw(n->val);
+			}
+			return 0;
+		case X_VAR:
+			jgetvar(0, n->n);
+			return 0;
+		case X_ELEM:
+			jexpr(n->a);
+			jelem(n->n);
+			if (((short int *)array_esz)[n->n] == 1) {
+				jb(0x0F); jb(0xB6); jb(0x04); jb(0x02);   /* movzx eax, byte [rdx+rax] */
+			}
+			else {
+				jb(0x0F); jb(0xBF); jb(0x04); jb(0x42);   /* movsx eax, word [rdx+rax*2] */
+			}
+			return 0;
+		case X_NOT:
+			jexpr(n->a);
+			jb(0xF7); jb(0xD0);       /* not eax */
+			return 0;
+		case X_HOIST:
+			jexpr(n->a);
+			return 0;
+		case X_FUNC:              /* ABS */
+			jexpr(cmp_node[n->a].a);
+			jb(0x89); jb(0xC1);       /* mov ecx, eax */
+			jb(0xF7); jb(0xD9);       /* neg ecx */
+			jb(0x85); jb(0xC0);       /* test eax, eax */
+			jb(0x0F); jb(0x48); jb(0xC1);   /* cmovs eax, ecx */
+			jsext();
+			return 0;
+	}
+
+	/* the operators, with the right operand in ecx */
+	jexpr(n->a);
+	b = cmp_node + n->b;
+	if (b->op == X_NUM) {
+		jb(0xB9); jw(b->val);      /* mov ecx, val */
+	}
+	else if (b->op == X_VAR)
+		jgetvar(1, b->n);
+	else {
+		jb(0x50);                  /* push rax */
+		jexpr(n->b);
+		jb(0x89); jb(0xC1);        /* mov ecx, eax */
+		jb(0x58);                  /* pop rax */
+	}
+	switch (n->op) {
+		case X_ADD:
+			jb(0x01); jb(0xC8);
+			jsext();
+			break;
+		case X_SUB:
+			jb(0x29); jb(0xC8);
+			jsext();
+			break;
+		case X_MUL:
+			jb(0x0F); jb(0xAF); jb(0xC1);
+			jsext();
+			break;
+		case X_DIV:
+		case X_MOD:
+			if (b->op != X_NUM || b->val == 0) {
+				jb(0x85); jb(0xC9);    /* test ecx, ecx */
+				jjump(CC_E, J_EXIT, jit_cur*2);
+			}
+			jb(0x99);                 /* cdq */
+			jb(0xF7); jb(0xF9);       /* idiv ecx */
+			if (n->op == X_MOD) {
+				jb(0x89); jb(0xD0);   /* mov eax, edx */
+			}
+			jsext();
+			break;
+		case X_SHL:
+		case X_SHR:
+			jb(0x0F); jb(0xB7); jb(0xC0);   /* movzx eax, ax */
+			jb(0xD3); jb(n->op == X_SHL ? 0xE0 : 0xE8);   /* shl/shr eax, cl */
+			jb(0x31); jb(0xD2);             /* xor edx, edx */
+			jb(0x83); jb(0xF9); jb(15);     /* cmp ecx, 15 */
+			jb(0x0F); jb(0x47); jb(0xC2);   /* cmova eax, edx */
+			jsext();
+			break;
+		case X_AND:
+			jb(0x21); jb(0xC8);
+			break;
+		case X_OR:
+			jb(0x09); jb(0xC8);
+			break;
+		case X_XOR:
+			jb(0x31); jb(0xC8);
+			break;
+		default:                      /* comparisons */
+			jb(0x39); jb(0xC8);       /* cmp eax, ecx */
+			jb(0x0F);
+			switch (n->op) {
+				case X_GE: jb(0x90 | CC_GE); break;
+				case X_NE: jb(0x90 | CC_NE); break;
+				case X_GT: jb(0x90 | CC_G); break;
+				case X_EQ: jb(0x90 | CC_E); break;
+				case X_LE: jb(0x90 | CC_LE); break;
+				case X_LT: jb(0x90 | CC_L); break;
+			}
+			jb(0xC0);                 /* setcc al */
+			jb(0x0F); jb(0xB6); jb(0xC0);   /* movzx eax, al */
+			break;
+	}
+}
+
+/* machine code for statement s of a loop of variable var, -1 for a GOTO loop */
+voidret jstmt(s, var)
+short int s;
+int var;
+{
+	struct cstmt *st = cmp_stmt + s;
+	struct cnode *t;
+	struct stack_for_frame fr;
+	uchar *p;
+
+	jit_cur = s;
+	switch (st->op) {
+		case S_REM:
+			return 0;   /* the end of the line */
+		case S_LET:
+			t = cmp_node + st->a;
+			if (!jit_ok(st->b) || t->op == X_ELEM && !jit_ok(st->a))
+				break;
+			jexpr(st->b);
+			if (t->op == X_VAR) {
+				jsetvar(t->n);
+				return 0;
+			}
+			jb(0x50);                 /* push rax */
+			jexpr(t->a);
+			jelem(t->n);
+			jb(0x59);                 /* pop rcx */
+			if (((short int *)array_esz)[t->n] == 1) {
+				jb(0x88); jb(0x0C); jb(0x02);   /* mov [rdx+rax], cl */
+			}
+			else {
+				jb(0x66); jb(0x89); jb(0x0C); jb(0x42);   /* mov [rdx+rax*2], cx */
+			}
+			return 0;
+		case S_IF:
+			if (!jit_ok(st->a))
+				break;
+			jexpr(st->a);
+			jb(0x85); jb(0xC0);       /* test eax, eax */
+			jgoto(CC_E, st->next_line);
+			return 0;
+		case S_GOTO:
+			if (st->target < 0)
+				break;
+			jgoto(-1, st->target);
+			return 0;
+		case S_NEXT:
+			if (st->n != 'A' + var)
+				break;
+			jgetvar(0, var);
+			jb(0x0F); jb(0xBF); jb(0x4E);   /* movsx ecx, word [rsi+step] */
+			jb((uchar *)&fr.step - (uchar *)&fr);
+			jb(0x01); jb(0xC8);             /* add eax, ecx */
+			jsext();
+			jsetvar(var);
+			jb(0x0F); jb(0xBF); jb(0x56);   /* movsx edx, word [rsi+terminal] */
+			jb((uchar *)&fr.terminal - (uchar *)&fr);
+			jb(0x85); jb(0xC9);             /* test ecx, ecx */
+			p = jc;
+			jb(0x78); jb(0);                /* js down */
+			jjump(CC_E, J_EXIT, s*2+1);     /* a step of 0 never goes round */
+			jb(0x39); jb(0xD0);             /* cmp eax, edx */
+			jgoto(CC_LE, jit_head);
+			jjump(-1, J_EXIT, s*2+1);
+			p[1] = jc - (p+2);
+			jb(0x39); jb(0xD0);             /* down: cmp eax, edx */
+			jgoto(CC_GE, jit_head);
+			jjump(-1, J_EXIT, s*2+1);
+			return 0;
+	}
+
+	/* anything else is left to loop() */
+	jb(0xB8); jw(s*2);
+	jjump(-1, J_EPI, 0);
+}
+
+/* count the uses of variables in node x */
+voidret jit_uses(x, uses)
+short int x;
+short int *uses;
+{
+	struct cnode *n;
+
+	while (x >= 0) {
+		n = cmp_node + x;
+		switch (n->op) {
+			case X_NUM:
+			case X_STR:
+				return 0;
+			case X_VAR:
+				uses[n->n]++;
+				return 0;
+		}
+		jit_uses(n->a, uses);
+		x = n->b;
+	}
+}
+
+/* Machine code for the statements head to end, a loop of variable var
+ * or -1 for a GOTO loop, put at jc. It is called as code(variables_table,
+ * frame) and gives back what loop() is to do next, as for J_EXIT.
+ * Returns 0 if it doesn't fit.
+ */
+uchar *jit_emit(head, end, var)
+short int head;
+short int end;
+int var;
+{
+	short int uses[26];
+	short int s, i, v, best;
+	uchar *entry, *epi, *to;
+	struct cstmt *st;
+
+	jit_head = head;
+	jit_end = end;
+	jit_nfix = 0;
+	jit_full = 0;
+
+	/* registers for the variables used most */
+	for (v=0; v<26; v++) {
+		uses[v] = 0;
+		jit_reg[v] = -1;
+	}
+	if (var >= 0)
+		uses[var] += 2;
+	for (s=head; s<=end; s++) {
+		st = cmp_stmt + s;
+		if (st->op == S_LET || st->op == S_IF) {
+			jit_uses(st->a, uses);
+			jit_uses(st->b, uses);
+		}
+	}
+	for (i=0; i<JIT_REGS; i++) {
+		best = -1;
+		for (v=0; v<26; v++)
+			if (uses[v] > 0 && jit_reg[v] < 0 && (best < 0 || uses[v] > uses[best]))
+				best = v;
+		if (best < 0)
+			break;
+		jit_reg[best] = jit_regs[i];
+	}
+
+	entry = jc;
+	jb(0x55);                          /* push rbp */
+	jb(0x48); jb(0x89); jb(0xE5);      /* mov rbp, rsp */
+	jb(0x53);                          /* push rbx */
+	jb(0x41); jb(0x54);                /* push r12 ... */
+	jb(0x41); jb(0x55);
+	jb(0x41); jb(0x56);
+	jb(0x41); jb(0x57);                /* ... r15 */
+	for (v=0; v<26; v++)
+		if (jit_reg[v] >= 0) {
+			if (jit_reg[v] >= 8)
+				jb(0x44);
+			jb(0x0F); jb(0xBF); jb(0x47 | (jit_reg[v] & 7) << 3); jb(v*2);   /* movsx r, [rdi+2v] */
+		}
+	jb(0x41); jb(0xBB); jw(JIT_SPAN);  /* mov r11d, JIT_SPAN */
+
+	for (s=head; s<=end; s++) {
+		jit_lab[s] = jc;
+		jstmt(s, var);
+	}
+	jb(0xB8); jw((end+1)*2);           /* off the end of the loop */
+
+	epi = jc;
+	for (v=0; v<26; v++)
+		if (jit_reg[v] >= 0) {
+			jb(0x66);
+			if (jit_reg[v] >= 8)
+				jb(0x44);
+			jb(0x89); jb(0x47 | (jit_reg[v] & 7) << 3); jb(v*2);   /* mov [rdi+2v], r */
+		}
+	jb(0x48); jb(0x8D); jb(0x65); jb(-40);   /* lea rsp, [rbp-40] */
+	jb(0x41); jb(0x5F);                /* pop r15 ... */
+	jb(0x41); jb(0x5E);
+	jb(0x41); jb(0x5D);
+	jb(0x41); jb(0x5C);                /* ... r12 */
+	jb(0x5B);                          /* pop rbx */
+	jb(0x5D);                          /* pop rbp */
+	jb(0xC3);                          /* ret */
+
+	/* fill in the jumps, making the exits as they are needed */
+	for (i=0; i<jit_nfix && !jit_full; i++) {
+		switch (jit_fix[i].kind) {
+			case J_STMT:
+				to = jit_lab[jit_fix[i].val];
+				break;
+			case J_EPI:
+				to = epi;
+				break;
+			default:
+				for (s=0; s<i; s++)
+					if (jit_fix[s].kind == J_EXIT && jit_fix[s].val == jit_fix[i].val)
+						break;
+				if (s < i) {
+					to = jit_fix[s].at + 4 + *(int *)jit_fix[s].at;
+					break;
+				}
+				to = jc;
+				jb(0xB8); jw(jit_fix[i].val);   /* mov eax, val */
+				jb(0xE9); jw(epi - (jc+4));     /* jmp epi */
+				break;
+		}
+		if (!jit_full)
+			*(int *)jit_fix[i].at = to - (jit_fix[i].at + 4);
+	}
+	if (jit_full) {
+		jc = entry;
+		return 0;
+	}
+	return entry;
+}
+
+/* jit_emit() with the buffer writable, and executable but no longer
+ * writable again once the code is in. Returns 0 if the code can't be
+ * made or run.
+ */
+uchar *jit_build(head, end, var)
+short int head;
+short int end;
+int var;
+{
+	uchar *code;
+
+	if (jit_dead)
+		return 0;
+	if (jit_buf == 0) {
+		jit_buf = (uchar *)mmap(0, JIT_CODE, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (jit_buf == (uchar *)MAP_FAILED) {
+			jit_buf = 0;
+			return 0;
+		}
+		jc = jit_buf;
+	} else if (mprotect(jit_buf, JIT_CODE, PROT_READ|PROT_WRITE) != 0)
+		return 0;
+	code = jit_emit(head, end, var);
+	if (mprotect(jit_buf, JIT_CODE, PROT_READ|PROT_EXEC) != 0) {
+		/* none of it can run now, so interpret from here on */
+		jit_reset();
+		jit_dead = 1;
+		return 0;
+	}
+	return code;
+}
+
+/* the slot of a loop at line offset off */
+struct jit_slot *jit_slot(off, goto_loop)
+unsigned short off;
+int goto_loop;
+{
+	unsigned short tag = off*2 + goto_loop + 1;
+	struct jit_slot *j = jit_slots + (tag*31) % JIT_SLOTS;
+
+	if (j->tag != tag) {
+		j->tag = tag;
+		j->hits = 0;
+		j->code = 0;
+		j->failed = 0;
+	}
+	return j;
+}
+
+/* run the machine code of the loop at line, then set up loop() to carry on */
+uchar jit_run(code, f, line)
+uchar *code;
+uchar *f;
+uchar *line;
+{
+	int (*fn)() = (int (*)())code;
+	int k;
+	struct cstmt *st;
+
+	jit_line = line;
+	k = (*fn)(variables_table, f);
+	jit_line = 0;
+	st = cmp_stmt + k/2;
+
+	if (k/2 >= cmp_stmts) {
+		current_line = pgm_end;
+		return JIT_LINE;
+	}
+	current_line = pgm_start + st->line;
+	if (k & 1) {
+		/* the loop is over */
+		sp = f + sizeof(struct stack_for_frame);
+		txtpos = pgm_start + st->end;
+		return JIT_NEXT;
+	}
+	txtpos = pgm_start + st->txt;
+	return JIT_STMT;
+}
+
+/* The FOR loop of frame f is going round again. Returns JIT_NO to carry
+ * on interpreting, or runs the loop as machine code.
+ */
+uchar jit_loop(f)
+uchar *f;
+{
+	struct stack_for_frame *fr = (struct stack_for_frame *)f;
+	struct jit_slot *j;
+	short int s, end;
+
+	if (fr->sff_current_line == 0)
+		return JIT_NO;    /* direct mode */
+	j = jit_slot(fr->sff_current_line - pgm_start, 0);
+	if (j->code == 0) {
+		if (j->failed || ++j->hits < JIT_HOT)
+			return JIT_NO;
+		j->failed = 1;
+		if (!ir_compile())
+			return JIT_NO;
+		/* the FOR ends its line; the loop runs from the next line to the NEXT */
+		s = cmp_stmt[c_findstmt(fr->sff_current_line - pgm_start)].next_line;
+		if (cmp_stmt[s-1].op != S_FOR || 'A' + cmp_stmt[s-1].n != fr->for_var)
+			return JIT_NO;
+		for (end=s; end<cmp_stmts; end++)
+			if (cmp_stmt[end].op == S_NEXT && cmp_stmt[end].n == fr->for_var)
+				break;
+		if (end == cmp_stmts)
+			return JIT_NO;
+		j->code = jit_build(s, end, fr->for_var - 'A');
+		if (j->code == 0)
+			return JIT_NO;
+	}
+	return jit_run(j->code, f, fr->sff_current_line);
+}
+
+/* A GOTO from line from back to line to. Returns JIT_NO to carry on
+ * interpreting, or runs the loop as machine code.
+ */
+uchar jit_goto(from, to)
+uchar *from;
+uchar *to;
+{
+	struct jit_slot *j = jit_slot(to - pgm_start, 1);
+	short int s;
+
+	if (j->code == 0) {
+		if (j->failed || ++j->hits < JIT_HOT)
+			return JIT_NO;
+		j->failed = 1;
+		if (!ir_compile())
+			return JIT_NO;
+		s = c_findstmt(from - pgm_start);
+		j->code = jit_build(c_findstmt(to - pgm_start), cmp_stmt[s].next_line - 1, -1);
+		if (j->code == 0)
+			return JIT_NO;
+	}
+	return jit_run(j->code, (uchar *)0, to);
+}
+
+/* the program or the arrays have changed: forget all the machine code */
+voidret jit_reset()
+{
+	short int i;
+
+	for (i=0; i<JIT_SLOTS; i++)
+		jit_slots[i].tag = 0;
+	jc = jit_buf;
+}
+
+#else
+
+uchar jit_loop(f)
+uchar *f;
+{
+	return JIT_NO;
+}
+
+uchar jit_goto(from, to)
+uchar *from;
+uchar *to;
+{
+	return JIT_NO;
+}
+
+voidret jit_reset()
+{
+}
+
+#endif
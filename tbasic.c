@@ -1,1688 +1,4961 @@
-/*  tbasic.c : An implementation of Not-So-TinyBASIC in C
-
- Scott Baker, https://www.smbaker.com/
-
- Supports 26 16-bit integer variables named A-Z. Also supports up
- to 26 arrays of 16-bit integer variables also named A-Z. You can
- have both a simple variable and an array of the same name should
- you choose to do so (though you may confuse yourself).
- 
- Code is split into a host-agnostic portion (tbasic.c) and a host
- specific version (host.c), with the intent that porting to a new
- environement should generally only involve changes to host.c and
- not changes to tbasic.c.
-
- The dialect of C is an early variant of K&R, with old-style function
- prototypes and missing some features. The code is the least common
- denominator that should compile on old as well as new environments
- such as Linux.
-
- The code is very much "assembly converted to C and hacked upon by
- each person to create features they inidividually deemed necessary".
- It is not the quality of a green field implementation and carries
- much baggage.
-
- Based on Arduino Tiny Basic, by: Mike Field - hamster@snap.net.nz
- Based on TinyBasic for 68000, by Gordon Brandly
- (see http://members.shaw.ca/gbrandly/68ktinyb.html)
-
- which itself was derived from Palo Alto Tiny BASIC as 
- published in the May 1976 issue of Dr. Dobb's Journal.
-
- 0.04 01/08/2022  : modified for CPM-8000's wonky zcc compiler
- 								  : added hex notation &Hxx
-									: added load, save commands
-									: added DIM for dimensioning arrays
-									: added FRE() and RAND() functions
- 
- 0.03 21/01/2011 : Added INPUT routine 
-                 : Reorganised memory layout
-                 : Expanded all error messages
-                 : Break key added
-                 : Removed the calls to printf (left by debugging)
-
-CP/M-8000 Instructions:
-	zcc tbasic.c
-	zcc host.c
-	a:asz8k -o inout.o inout.8kn
-	a:ld8k -w -s -o tbasic.z8k startup.o tbasic.o host.o inout.o -lcpm
-
-Linux Build Instructions:
-  make
-*/
-
-#include <stdio.h>
-#include "host.h"
-
-#define MAXLINENUM 65000
-
-/* return values for procline() */
-#define PROCLINE_EOF 0
-#define PROCLINE_OKAY 1
-#define PROCLINE_DIRECT 2
-#define PROCLINE_BADLINE 3
-#define PROCLINE_DELETE 4
-#define PROCLINE_EMPTY 5
-
-/* ASCII Characters */
-#define TAB	'\t'
-#define BELL	'\b'
-#define DEL	'\177'
-#define SPACE   ' '
-#define CTRLC	0x03
-#define CTRLH	0x08
-#define CTRLS	0x13
-#define CTRLX	0x18
-
-#define debugf if (0) printf
-
-typedef unsigned short LINENUM;
-
-/***********************************************************/
-/* Keyword table and constants - the last character has 0x80 added to it */
-uchar keywords[] = {
-	'L','I','S','T'+0x80,
-	'L','O','A','D'+0x80,
-	'N','E','W'+0x80,
-	'R','U','N'+0x80,
-	'S','A','V','E'+0x80,
-	'N','E','X','T'+0x80,
-	'L','E','T'+0x80,
-	'I','F'+0x80,
-	'G','O','T','O'+0x80,
-	'G','O','S','U','B'+0x80,
-	'R','E','T','U','R','N'+0x80,
-	'R','E','M'+0x80,
-	'F','O','R'+0x80,
-	'I','N','P','U','T'+0x80,
-	'P','R','I','N','T'+0x80,
-	'P','O','K','E'+0x80,
-	'S','T','O','P'+0x80,
-	'B','Y','E'+0x80,
-	'S','Y','S','T','E','M'+0x80,    /* synonym for BYE */
-	'O','U','T'+0x80,
-  'S','L','E','E','P'+0x80,
-  'C','L','E','A','R'+0x80,
-	'D','I','M'+0x80,
-	'E','N','D'+0x80,               /* synomym for STOP but with the Break! message */
-	0
-};
-
-#define KW_LIST		0
-#define KW_LOAD		1
-#define KW_NEW		2
-#define KW_RUN		3
-#define KW_SAVE		4
-#define KW_NEXT		5
-#define KW_LET		6
-#define KW_IF		7
-#define KW_GOTO		8
-#define KW_GOSUB	9
-#define KW_RETURN	10
-#define KW_REM		11
-#define KW_FOR		12
-#define KW_INPUT	13
-#define KW_PRINT	14
-#define KW_POKE		15
-#define KW_STOP		16
-#define KW_BYE		17
-#define KW_SYSTEM 18
-#define KW_OUT    19
-#define KW_SLEEP	20
-#define KW_CLEAR  21
-#define KW_DIM    22
-#define KW_END    23
-#define KW_DEFAULT	24
-
-
-struct stack_for_frame {
-	char frame_type;
-	char for_var;
-	short int terminal;
-	short int step;
-	uchar *sff_current_line;
-	uchar *sff_txtpos;
-};
-
-struct stack_gosub_frame {
-	char frame_type;
-	uchar *sgf_current_line;
-	uchar *sgf_txtpos;
-};
-
-uchar func_tab[] = {
-	'P','E','E','K'+0x80,
-	'A','B','S'+0x80,
-	'H','I','G','H'+0x80,
-	'L','O','W'+0x80,
-	'I','N','P'+0x80,
-	'F','R','E'+0x80,
-	'R','A','N', 'D'+0x80,
-	0
-};
-#define FUNC_PEEK  0
-#define FUNC_ABS  1
-#define FUNC_HIGH  2
-#define FUNC_LOW  3
-#define FUNC_INP 4
-#define FUNC_FRE 5
-#define FUNC_RAND 6
-#define FUNC_UNKNOWN 7
-
-uchar to_tab[] = {
-	'T','O'+0x80,
-	0
-};
-
-uchar step_tab[] = {
-	'S','T','E','P'+0x80,
-	0
-};
-
-uchar relop_tab[] = {
-	'>','='+0x80,
-	'<','>'+0x80,
-	'>'+0x80,
-	'='+0x80,
-	'<','='+0x80,
-	'<'+0x80,
-	0
-};
-
-#define RELOP_GE		0
-#define RELOP_NE		1
-#define RELOP_GT		2
-#define RELOP_EQ		3
-#define RELOP_LE		4
-#define RELOP_LT		5
-#define RELOP_UNKNOWN	        6
-
-uchar logop_tab[] = {
-	'A','N','D'+0x80,
-	'O','R'+0x80,
-	0
-};
-
-#define LOGOP_AND   0
-#define LOGOP_OR    1
-#define LOGOP_UNKNOWN 2
-
-#define NUM_VAR 27  /* why is this 27 and not 26 ?? */
-#define VAR_SIZE sizeof(short int) /* Size of variables in bytes */
-
-char fn[FNSIZE]; /* filename buffer */
-uchar *txtpos, *list_line;
-uchar exp_error;
-uchar *tempsp;
-uchar *stack_limit;
-uchar *pgm_start;
-uchar *pgm_end;
-uchar *stack; /* Software stack for things that should go on the CPU stack */
-uchar *variables_table;
-uchar *array_table;
-uchar *array_sz;
-uchar *current_line;
-uchar *sp;
-uchar *top_sp; /* points to the top of the stack */
-#define STACK_GOSUB_FLAG 'G'
-#define STACK_FOR_FLAG 'F'
-uchar table_index;
-LINENUM linenum;
-uchar lecho;
-
-const uchar iomsg[] = "IO Error";
-const uchar okmsg[]		= "OK";
-const uchar badlinemsg[]		= "Invalid line number";
-const uchar invalidexprmsg[] = "Invalid expression";
-const uchar syntaxmsg[] = "Syntax Error";
-const uchar badinputmsg[] = "\nBad number";
-const uchar boundsmsg[] = "Bounds error";
-const uchar nomemmsg[]	= "Not enough memory!";
-const uchar initmsg[]	= "Z8000 TinyBasic, www.smbaker.com";
-const uchar memorymsg[]	= " bytes free.";
-const uchar breakmsg[]	= "break!";
-const uchar stackstuffedmsg[] = "Stack is stuffed!\n";
-const uchar unimplimentedmsg[]	= "Unimplemented";
-const uchar backspacemsg[]		= "\b \b";
-
-short int expression();
-uchar breakcheck();
-/***************************************************************************/
-voidret ignore_blanks()
-{
-	while(*txtpos == SPACE || *txtpos == TAB)
-		txtpos++;
-}
-
-/* zcc does not support "unsigned char" */
-#define SIGNCONV(x) (((x)<0) ? (256+(x)) : (x))
-
-/* zcc does not like word writes that are at odd addresses. Write it as two
- * bytes instead.
- */
-voidret encode_linenum(s, linenum)
-uchar *s;
-unsigned short linenum;
-{
-	*s = linenum >> 8;
-	*(s+1) = linenum & 0xFF;
-	/* *((unsigned short *)s) = linenum; */
-}
-
-/* see encode_linenum for explanation */
-unsigned short decode_linenum(s)
-uchar *s;
-{
-	return (SIGNCONV(*s) << 8) + SIGNCONV(*(s+1));
-	/* return *((LINENUM *)(s)); */
-}
-
-/***************************************************************************/
-voidret scantable(table)
-uchar *table;
-{
-	int i = 0;
-	ignore_blanks();
-	table_index = 0;
-	while(1)
-	{
-		/* Run out of table entries? */
-		if(table[0] == 0)
-      return 0;
-
-		/* Do we match this character? */
-		if(txtpos[i] == table[0])
-		{
-			i++;
-			table++;
-		}
-		else
-		{
-			/* do we match the last character of keyword (with 0x80 added)? If so, return */
-			if(txtpos[i]+0x80 == SIGNCONV(table[0]))
-			{
-				txtpos += i+1;  /* Advance the pointer to following the keyword */
-				ignore_blanks();
-				return 0;
-			}
-
-			/* Forward to the end of this keyword */
-			while((SIGNCONV(table[0]) & 0x80) == 0)
-				table++;
-
-			/* Now move on to the first character of the next word, and reset the position index */
-			table++;
-			table_index++;
-			i = 0;
-		}
-	}
-}
-
-/***************************************************************************/
-voidret pushb(b)
-uchar b;
-{
-	sp--;
-	*sp = b;
-}
-
-/***************************************************************************/
-uchar popb()
-{
-	uchar b;
-	b = *sp;
-	sp++;
-	return b;
-}
-
-/***************************************************************************/
-voidret printnum(num)
-int num;
-{
-	int digits = 0;
-
-	if(num < 0)
-	{
-		num = -num;
-		putch('-');
-	}
-
-	do {
-		pushb(num%10+'0');
-		num = num/10;
-		digits++;
-	}
-	while (num > 0);
-
-	while(digits > 0)
-	{
-		putch(popb());
-		digits--;
-	}
-}
-/***************************************************************************/
-unsigned short testnum()
-{
-	unsigned short num = 0;
-	ignore_blanks();
-	
-	while(*txtpos>= '0' && *txtpos <= '9' )
-	{
-		/* Trap overflows */
-		if(num >= MAXLINENUM) /* was 0xFFFF/10, but this seems to be miscomputed in zcc */
-		{
-			num = 0xFFFF;
-			break;
-		}
-
-		num = num *10 + *txtpos - '0';
-		txtpos++;
-	}
-	return	num;
-}
-
-/***************************************************************************/
-uchar check_statement_end()
-{
-	ignore_blanks();
-	return (*txtpos == NL) || (*txtpos == ':');
-}
-
-/***************************************************************************/
-voidret printnnl(msg)
-const uchar *msg;
-{
-	while(*msg)
-	{
-		putch(*msg);
-		msg++;
-	}
-}
-
-/***************************************************************************/
-uchar print_quoted_string()
-{
-	int i=0;
-	uchar delim = *txtpos;
-	if(delim != '"' && delim != '\'')
-		return 0;
-	txtpos++;
-
-	/* Check we have a closing delimiter */
-	while(txtpos[i] != delim)
-	{
-		if(txtpos[i] == NL)
-			return 0;
-		i++;
-	}
-
-	/* Print the characters */
-	while(*txtpos != delim)
-	{
-		putch(*txtpos);
-		txtpos++;
-	}
-	txtpos++; /* Skip over the last delimiter */
-	ignore_blanks();
-
-	return 1;
-}
-
-/***************************************************************************/
-uchar get_quoted_string(dest)
-char *dest;
-{
-	int i=0;
-	int maxlen=FNSIZE-1;
-	uchar delim = *txtpos;
-	if(delim != '"' && delim != '\'')
-		return 0;
-	txtpos++;
-
-	/* Check we have a closing delimiter */
-	while(txtpos[i] != delim)
-	{
-		if(txtpos[i] == NL)
-			return 0;
-		i++;
-	}
-
-	/* Print the characters */
-	while(*txtpos != delim)
-	{
-    if (maxlen<=0) {
-			return 0; /* complain */
-		}
-
-		*dest = *txtpos;
-		dest++;
-		txtpos++;
-		maxlen--;
-	}
-	txtpos++; /* Skip over the last delimiter */
-	ignore_blanks();
-
-	*dest = '\0';
-
-	return 1;
-}
-
-/***************************************************************************/
-voidret printmsg(msg)
-const uchar *msg;
-{
-	printnnl(msg);
-  put_nl();
-}
-
-/***************************************************************************/
-uchar getln(prompt)
-char prompt;
-{
-	if (prompt) {
-	  putch(prompt);
-	}
-	txtpos = pgm_end+sizeof(LINENUM);
-
-	while(1)
-	{
-		char c = getch();
-		switch(c)
-		{
-			case EOFC:
-			case CR:
-			case NL:
-			  if (lecho) {
-          put_nl();
-				}
-				/* Terminate all strings with a NL */
-				txtpos[0] = NL;
-				return 1;
-			case CTRLC:
-				return 0;
-			case CTRLH:
-			case DEL:
-				if(txtpos == pgm_end)
-					break;
-				txtpos--;
-				printnnl(backspacemsg);
-				break;
-			default:
-				/* We need to leave at least one space to allow us to shuffle the line into order */
-				if(txtpos == sp-2)
-					putch(BELL);
-				else
-				{
-					txtpos[0] = c;
-					txtpos++;
-					if (lecho)
-					  putch(c);
-				}
-		}
-	}
-}
-
-/***************************************************************************/
-uchar *findline()
-{
-	uchar *line = pgm_start;
-	while(1)
-	{
-		if(line == pgm_end) {
-			return line;
-		}
-
-		if (decode_linenum(line) >= linenum) {
-			return line;
-		}
-
-		/* Add the line length onto the current address, to get to the next line; */
-		line += line[sizeof(LINENUM)];
-	}
-}
-
-/***************************************************************************/
-voidret toUppercaseBuffer()
-{
-	uchar *c = pgm_end+sizeof(LINENUM);
-	uchar quote = 0;
-
-	while(*c != NL)
-	{
-		/* Are we in a quoted string? */
-		if(*c == quote)
-			quote = 0;
-		else if(*c == '"' || *c == '\'')
-			quote = *c;
-		else if(quote == 0 && *c >= 'a' && *c <= 'z')
-			*c = *c + 'A' - 'a';
-		c++;
-	}
-}
-
-/***************************************************************************/
-voidret printline()
-{
-	LINENUM line_num;
-
-	line_num = decode_linenum(list_line);
-	
-  list_line += sizeof(LINENUM) + sizeof(char);
-
-	/* Output the line */
-	printnum(line_num);
-	putch(' ');
-	while(*list_line != NL) {
-		putch(*list_line);
-		list_line++;
-	}
-	list_line++;
-	put_nl();
-}
-
-voidret printpgm(linestart)
-unsigned short linestart;
-{
-	list_line = findline();
-	while(list_line != pgm_end) {
-      printline();
-	}
-}
-
-voidret dim(name, size)
-uchar name;
-unsigned short size;
-{
-	int i;
-	unsigned short arr_start;
-
-	if (((short int *)array_sz)[name] >= size) {
-		/* use existing array */
-    arr_start = ((short int *)array_table)[name];
-	} else {
-		/* new array, or expanded array */
-		/* note: expanding array will cause loss of space */
-	  top_sp = top_sp - size*VAR_SIZE;
-	  sp = top_sp;
-	  arr_start = top_sp-memory;
-	}
-
-  /* clear the array */
-	for (i=0; i<size; i++) {
-		((short int *) (memory+arr_start))[i] = 0;
-	}
-
-	((short int *)array_table)[name] = arr_start;
-	((short int *)array_sz)[name] = size;
-}
-
-/***************************************************************************/
-short int expr4()
-{
-	uchar f;
-	short int a = 0;
-	short int b = 0;
-
-	ignore_blanks(); /* smbaker */
-
-	if(*txtpos == '0') {
-		txtpos++;
-		a = 0;
-		goto success;
-	}
-
-  /* is it a decimal number */
-	if(*txtpos >= '1' && *txtpos <= '9')
-	{
-		do 	{
-			a = a*10 + *txtpos - '0';
-			txtpos++;
-		} while(*txtpos >= '0' && *txtpos <= '9');
-		goto success;
-	}
-
-  /* is it a hexadecimal number? */
-	if ((*txtpos == '&') && (*(txtpos+1)=='H') || ((*txtpos+1)=='h'))
-	{
-		txtpos++;
-		txtpos++;
-		do {
-			if ((*txtpos >= 'a') && (*txtpos <= 'f')) {
-				a = a * 16 + *txtpos - 'a' + 10;
-			} else if ((*txtpos >= 'A') && (*txtpos <= 'F')) {
-				a = a * 16 + *txtpos - 'A' + 10;
-			} else if ((*txtpos >= '0') && (*txtpos <= '9')) {
-				a = a * 16 + *txtpos - '0';
-			} else {
-				break;
-			}
-			txtpos++;
-		} while (1);
-		goto success;
-	}
-
-	/* Is it a function or variable reference? */
-	if(txtpos[0] >= 'A' && txtpos[0] <= 'Z')
-	{
-		/* is it an array reference */
-		if (txtpos[1]=='(') {
-			unsigned int arr_ofs = ((short int *)array_table)[*txtpos - 'A'];
-			unsigned int arr_siz = ((short int *)array_sz)[*txtpos - 'A'];
-			unsigned int index;
-			txtpos++; /* now pointing at the paren */
-			index = expression();
-			if ((index < 0) || (index >= arr_siz)) {
-				printmsg(boundsmsg);
-				goto expr4_error;
-			}
-			a = ((short int *) (memory+arr_ofs))[index];
-			goto success;
-		}
-
-		/* Is it a variable reference (single alpha) */
-		if(txtpos[1] < 'A' || txtpos[1] > 'Z')
-		{
-			a = ((short int *)variables_table)[*txtpos - 'A'];
-			txtpos++;
-			goto success;
-		}
-
-		/* Is it a function with a single parameter */
-		scantable(func_tab);
-		if(table_index == FUNC_UNKNOWN)
-			goto expr4_error;
-
-		f = table_index;
-
-		/* Pseudo Functions added by DCJ for things that need no parms */
-		if (f == FUNC_HIGH) {
-			a=1;
-			goto success;
-		}
-		if (f == FUNC_LOW) {
-			a=0;
-			goto success;
-		}
-
-		if(*txtpos != '(')
-			goto expr4_error;
-
-		txtpos++;
-		a = expression();
-		if(*txtpos != ')')
-				goto expr4_error;
-		txtpos++;
-		switch(f)
-		{
-			case FUNC_PEEK:
-			  a = peek(a);
-				goto success;
-			case FUNC_ABS:
-				if(a < 0)
-					a = -a;
-				goto success;
-			case FUNC_INP:
-			  a = inp(a);
-				goto success;
-			case FUNC_FRE:
-			  a = sp-pgm_end;
-				goto success;
-			case FUNC_RAND:
-			  a = rand(a);
-				goto success;
-		}
-	}
-
-	if(*txtpos == '(')
-	{
-		txtpos++;
-		a = expression();
-		if(*txtpos != ')')
-			goto expr4_error;
-
-		txtpos++;
-		goto success;
-	}
-
-expr4_error:
-	exp_error = 1;
-
-success:
-	ignore_blanks();
-	return a;
-}
-
-/***************************************************************************/
-short int expr3()
-{
-	short int a,b;
-
-	a = expr4();
-	while(1)
-	{
-		if(*txtpos == '*') {
-			txtpos++;
-			b = expr4();
-			a *= b;
-		}
-		else if(*txtpos == '/') {
-			txtpos++;
-			b = expr4();
-			if(b != 0)
-				a /= b;
-			else
-				exp_error = 1;
-		} else if (*txtpos == 'M' && *(txtpos+1)=='O' && *(txtpos+2)=='D') {
-			txtpos++;
-			txtpos++;
-			txtpos++;
-			b=expr4();
-			a = a % b;
-		}
-		else
-			return a;
-	}
-}
-
-/***************************************************************************/
-short int expr2()
-{
-	short int a,b;
-
-	if(*txtpos == '-' || *txtpos == '+')
-		a = 0;
-	else
-		a = expr3();
-
-	while(1)
-	{
-		if(*txtpos == '-')
-		{
-			txtpos++;
-			b = expr3();
-			a -= b;
-		}
-		else if(*txtpos == '+')
-		{
-			txtpos++;
-			b = expr3();
-			a += b;
-		}
-		else
-			return a;
-	}
-}
-
-/***************************************************************************/
-short int expr1()
-{
-	short int a,b;
-
-	a = expr2();
-	/* Check if we have an error */
-	if(exp_error)	return a;
-
-	scantable(relop_tab);
-	if(table_index == RELOP_UNKNOWN)
-		return a;
-	
-	switch(table_index)
-	{
-	case RELOP_GE:
-		b = expr2();
-		if(a >= b) return 1;
-		break;
-	case RELOP_NE:
-		b = expr2();
-		if(a != b) return 1;
-		break;
-	case RELOP_GT:
-		b = expr2();
-		if(a > b) return 1;
-		break;
-	case RELOP_EQ:
-		b = expr2();
-		if(a == b) return 1;
-		break;
-	case RELOP_LE:
-		b = expr2();
-		if(a <= b) return 1;
-		break;
-	case RELOP_LT:
-		b = expr2();
-		if(a < b) return 1;
-		break;
-	}
-	return 0;
-}
-
-short int expression()
-{
-	short int a,b;
-
-	a = expr1();
-	/* Check if we have an error */
-	if(exp_error)	return a;
-
-	scantable(logop_tab);
-	if(table_index == LOGOP_UNKNOWN)
-		return a;
-	
-	switch(table_index)
-	{
-		case LOGOP_AND:
-		  b = expr1();
-			return (a & b);
-			break;
-
-		case LOGOP_OR:
-		  b = expr1();
-			return (a | b);
-			break;
-	}
-	
-	return 0;
-}
-
-uchar procline()
-{
-	uchar *start;
-	uchar *newEnd;
-	uchar linelen;
-
-	if (!getln('\0')) {
-		return PROCLINE_EOF;
-	}
-	toUppercaseBuffer();
-
-	txtpos = pgm_end+sizeof(unsigned short);
-
-	/* Find the end of the freshly entered line */
-	linelen=0;
-	while(*txtpos != NL) {
-		linelen++;
-		txtpos++;
-	}
-
-	/* Move it to the end of program_memory */
-	{
-		uchar *dest;
-		dest = sp-1;
-
-    /* zcc does not like words written to odd offsets */
-    if ((linelen%2)==0) {
-			dest--;
-		}
-
-		while(1)
-		{
-			*dest = *txtpos;
-			if(txtpos == pgm_end+sizeof(unsigned short))
-				break;
-			dest--;
-			txtpos--;
-		}
-		txtpos = dest;
-	}
-
-	/* Now see if we have a line number */
-	linenum = testnum();
-	ignore_blanks();
-	if(linenum == 0) {
-		if ((*txtpos==NL) || (*txtpos==CR)) {
-			return PROCLINE_EMPTY;
-		}
-	  return PROCLINE_DIRECT;
-	}
-
-	if(linenum == 0xFFFF)
-	  return PROCLINE_BADLINE;
-
-	/* Find the length of what is left, including the (yet-to-be-populated) line header */
-	linelen = 0;
-	while(txtpos[linelen] != NL)
-		linelen++;
-	linelen++; /* Include the NL in the line length */
-	linelen += sizeof(unsigned short)+sizeof(char); /* Add space for the line number and line length */
-
-	/* Now we have the number, add the line header. */
-	txtpos -= 3;
-	encode_linenum(txtpos, linenum);
-	txtpos[sizeof(LINENUM)] = linelen;
-
-	/* Merge it into the rest of the program */
-	start = findline();
-
-	/* If a line with that number exists, then remove it */
-	/*if(start != pgm_end && *((LINENUM *)start) == linenum) {*/
-	if (start != pgm_end && decode_linenum(start)==linenum) {
-		uchar *dest, *from;
-		unsigned tomove;
-
-		from = start + start[sizeof(LINENUM)];
-		dest = start;
-
-		tomove = pgm_end - from;
-		while( tomove > 0)
-		{
-			*dest = *from;
-			from++;
-			dest++;
-			tomove--;
-		}	
-		pgm_end = dest;
-	}
-
-	if(txtpos[sizeof(LINENUM)+sizeof(char)] == NL) {
-		/* If the line has no txt, it was just a delete */
-		return PROCLINE_DELETE;
-	}
-
-	/* Make room for the new line, either all in one hit or lots of little shuffles */
-	while(linelen > 0)
-	{	
-		unsigned int tomove;
-		uchar *from,*dest;
-		unsigned int space_to_make;
-
-		space_to_make = txtpos - pgm_end;
-
-		if(space_to_make > linelen)
-			space_to_make = linelen;
-		newEnd = pgm_end+space_to_make;
-		tomove = pgm_end - start;
-
-		/* Source and destination - as these areas may overlap we need to move bottom up */
-		from = pgm_end;
-		dest = newEnd;
-		while(tomove > 0)
-		{
-			from--;
-			dest--;
-			*dest = *from;
-			tomove--;
-		}
-
-		/* Copy over the bytes into the new space */
-		for(tomove = 0; tomove < space_to_make; tomove++)
-		{
-			*start = *txtpos;
-			txtpos++;
-			start++;
-			linelen--;
-		}
-		pgm_end = newEnd;
-	}
-	return PROCLINE_OKAY;
-}
-
-voidret loadpgm()
-{
-  uchar res;
-	uchar lecho_save;
-
-  lecho_save = lecho;
-	lecho = 0;
-	pgm_end = pgm_start;
-	while (1) {
-		res = procline();
-		if ((res != PROCLINE_OKAY) && (res != PROCLINE_EMPTY)) {
-			lecho = lecho_save;
-			return 0;
-		}
-	}
-}
-
-/* erase all variables and un-declare all arrays */
-voidret clear()
-{
-	int i;
-	for (i=0; i<26; i++) {
-		((short int *)variables_table)[i] = 0;
-		((short int *)array_table)[i] = 0;
-		((short int *)array_sz)[i] = 0;
-	}
-	top_sp = memory+sizeof(memory);
-	sp = top_sp;  /* Needed for printnum */
-}
-
-voidret initialize()
-{
-	variables_table = memory;
-	array_table = memory + NUM_VAR*VAR_SIZE;
-	array_sz = array_table + NUM_VAR*VAR_SIZE;
-	pgm_start = array_sz + NUM_VAR*VAR_SIZE;
-	pgm_end = pgm_start;
-	clear();
-}
-
-voidret banner()
-{
-	printmsg(initmsg);
-	printnum(sp-pgm_end);
-	printmsg(memorymsg);
-}
-
-/***************************************************************************/
-voidret loop(autorun)
-uchar autorun;
-{
-  if (autorun) {
-		current_line = pgm_start;
-		goto execline;
-	}
-
-warmstart:
-  if (autorun) {
-		/* autorun means autoexit when we're done */
-		return 0;
-	}
-	/* this signifies that it is running in 'direct' mode. */
-	current_line = 0;
-	sp = top_sp;
-	printmsg(okmsg);
-
-prompt:
-  switch (procline()) {
-		case PROCLINE_BADLINE:
-		  goto badline;
-		case PROCLINE_DIRECT:
-		  goto direct;
-		/* PROCLINE_OKAY */
-		/* PROCLINE_EOF */
-		/* PROCLINE_DELETE */
-		default:
-		  goto prompt;			
-	}
-
-unimplemented:
-	printmsg(unimplimentedmsg);
-	goto prompt;
-
-badline:	
-	printmsg(badlinemsg);
-	goto prompt;
-
-invalidexpr:
-	printmsg(invalidexprmsg);
-	goto prompt;
-
-ioerror:
-	printmsg(iomsg);
-	goto prompt;
-
-syntaxerror:
-	printmsg(syntaxmsg);
-	if(current_line != 0)  /* smbaker was typecast to vd ptr */
-	{
-       uchar tmp = *txtpos;
-		   if(*txtpos != NL)
-				*txtpos = '^';
-           list_line = current_line;
-           printline();
-           *txtpos = tmp;
-	}
-    put_nl();
-	goto prompt;
-
-stackstuffed:	
-	printmsg(stackstuffedmsg);
-	goto warmstart;
-
-nomem:	
-	printmsg(nomemmsg);
-	goto warmstart;
-
-run_next_statement:
-	while(*txtpos == ':')
-		txtpos++;
-	ignore_blanks();
-	if(*txtpos == NL)
-		goto execnextline;
-	goto interperateAtTxtpos;
-
-direct: 
-	txtpos = pgm_end+sizeof(LINENUM);
-	if(*txtpos == NL)
-		goto prompt;
-
-interperateAtTxtpos:
-        if(breakcheck())
-        {
-          printmsg(breakmsg);
-          goto warmstart;
-        }
-
-	scantable(keywords);
-	ignore_blanks();
-
-	switch(table_index)
-	{
-		case KW_LIST:
-			goto list;
-		case KW_LOAD:
-		  goto load;
-		case KW_NEW:
-			if(txtpos[0] != NL)
-				goto syntaxerror;
-			pgm_end = pgm_start;
-			clear();
-			goto prompt;
-		case KW_RUN:
-			current_line = pgm_start;
-			goto execline;
-		case KW_SAVE:
-			goto save;
-		case KW_NEXT:
-			goto next;
-		case KW_LET:
-			goto assignment;
-		case KW_IF:
-			{
-			short int val;
-			exp_error = 0;
-			val = expression();
-			if(exp_error || *txtpos == NL)
-				goto invalidexpr;
-			if(val != 0)
-				goto interperateAtTxtpos;
-			goto execnextline;
-			}
-		case KW_GOTO:
-			exp_error = 0;
-			linenum = expression();
-			if(exp_error || *txtpos != NL)
-				goto invalidexpr;
-			current_line = findline();
-			goto execline;
-
-		case KW_GOSUB:
-			goto gosub;
-		case KW_RETURN:
-			goto gosub_return; 
-		case KW_REM:	
-			goto execnextline;	/* Ignore line completely */
-		case KW_FOR:
-			goto forloop; 
-		case KW_INPUT:
-			goto input; 
-		case KW_PRINT:
-			goto print;
-		case KW_POKE:
-			goto do_poke;
-		case KW_STOP:
-		  printmsg(breakmsg);
-			/* fallthrough */
-		case KW_END:
-			/* This is the easy way to end - set the current line to the end of program attempt to run it */
-			if(txtpos[0] != NL)
-				goto syntaxerror;
-			current_line = pgm_end;
-			goto execline;
-		case KW_BYE:
-		case KW_SYSTEM:
-			/* Leave the basic interperater */
-			return 0;
-		case KW_OUT:
-		  goto do_outp;
-    case KW_SLEEP:
-			goto sleep;
-		case KW_CLEAR:
-		  goto do_clear;
-		case KW_DIM:
-		  goto do_dim;
-    case KW_DEFAULT:
-			goto assignment;
-		default:
-			break;
-	}
-	
-execnextline:
-	if(current_line == 0)		/* Processing direct commands? smbaker: was typecast to vdptr */
-		goto prompt;
-	current_line +=	 current_line[sizeof(LINENUM)];
-
-execline:
-  	if(current_line == pgm_end) /* Out of lines to run */
-		goto warmstart;
-	txtpos = current_line+sizeof(LINENUM)+sizeof(char);
-	goto interperateAtTxtpos;
-
-input:
-	{
-		uchar isneg=0;
-		uchar *temptxtpos;
-		short int *var;
-		ignore_blanks();
-		if(*txtpos < 'A' || *txtpos > 'Z')
-			goto syntaxerror;
-		var = ((short int *)variables_table)+*txtpos-'A';
-		txtpos++;
-		if(!check_statement_end())
-			goto syntaxerror;
-again:
-		temptxtpos = txtpos;
-		if(!getln('?'))
-			goto warmstart;
-
-		/* Go to where the buffer is read */
-		txtpos = pgm_end+sizeof(LINENUM);
-		if(*txtpos == '-')
-		{
-			isneg = 1;
-			txtpos++;
-		}
-
-		*var = 0;
-		do 	{
-			*var = *var*10 + *txtpos - '0';
-			txtpos++;
-		} while(*txtpos >= '0' && *txtpos <= '9');
-		ignore_blanks();
-		if(*txtpos != NL)
-		{
-			printmsg(badinputmsg);
-			goto again;
-		}
-	
-		if(isneg)
-			*var = -*var;
-
-		goto run_next_statement;
-	}
-
-forloop:
-	{
-		uchar var;
-		short int initial, step, terminal;
-
-		if(*txtpos < 'A' || *txtpos > 'Z')
-			goto syntaxerror;
-		var = *txtpos;
-		txtpos++;
-		
-		scantable(relop_tab);
-		if(table_index != RELOP_EQ)
-			goto syntaxerror;
-
-		exp_error = 0;
-		initial = expression();
-		if(exp_error)
-			goto invalidexpr;
-	
-		scantable(to_tab);
-		if(table_index != 0)
-			goto syntaxerror;
-	
-		terminal = expression();
-		if(exp_error)
-			goto invalidexpr;
-	
-		scantable(step_tab);
-		if(table_index == 0)
-		{
-			step = expression();
-			if(exp_error)
-				goto invalidexpr;
-		}
-		else
-			step = 1;
-		if(!check_statement_end())
-			goto syntaxerror;
-
-
-		if(!exp_error && *txtpos == NL)
-		{
-			struct stack_for_frame *f;
-			if(sp + sizeof(struct stack_for_frame) < stack_limit)
-				goto nomem;
-
-			sp -= sizeof(struct stack_for_frame);
-			f = (struct stack_for_frame *)sp;
-			((short int *)variables_table)[var-'A'] = initial;
-			f->frame_type = STACK_FOR_FLAG;
-			f->for_var = var;
-			f->terminal = terminal;
-			f->step     = step;
-			f->sff_txtpos   = txtpos;
-			f->sff_current_line = current_line;
-			goto run_next_statement;
-		}
-	}
-	goto syntaxerror;
-
-gosub:
-	exp_error = 0;
-	linenum = expression();
-	if(exp_error)
-		goto invalidexpr;
-	if(!exp_error && *txtpos == NL)
-	{
-		struct stack_gosub_frame *f;
-		if(sp + sizeof(struct stack_gosub_frame) < stack_limit)
-			goto nomem;
-
-		sp -= sizeof(struct stack_gosub_frame);
-		f = (struct stack_gosub_frame *)sp;
-		f->frame_type = STACK_GOSUB_FLAG;
-		f->sgf_txtpos = txtpos;
-		f->sgf_current_line = current_line;
-		current_line = findline();
-		goto execline;
-	}
-	goto syntaxerror;
-
-next:
-	/* Fnd the variable name */
-	ignore_blanks();
-	if(*txtpos < 'A' || *txtpos > 'Z')
-		goto syntaxerror;
-	txtpos++;
-	if(!check_statement_end())
-		goto syntaxerror;
-	
-gosub_return:
-	/* Now walk up the stack frames and find the frame we want, if present */
-	tempsp = sp;
-	while(tempsp < memory+sizeof(memory)-1)
-	{
-		switch(tempsp[0])
-		{
-			case STACK_GOSUB_FLAG:
-				if(table_index == KW_RETURN)
-				{
-					struct stack_gosub_frame *f = (struct stack_gosub_frame *)tempsp;
-					current_line	= f->sgf_current_line;
-					txtpos			= f->sgf_txtpos;
-					sp += sizeof(struct stack_gosub_frame);
-					goto run_next_statement;
-				}
-				/* This is not the loop you are looking for... so Walk back up the stack */
-				tempsp += sizeof(struct stack_gosub_frame);
-				break;
-			case STACK_FOR_FLAG:
-				/* Flag, Var, Final, Step */
-				if(table_index == KW_NEXT)
-				{
-					struct stack_for_frame *f = (struct stack_for_frame *)tempsp;
-					/* Is the the variable we are looking for? */
-					if(txtpos[-1] == f->for_var)
-					{
-						short int *varaddr = ((short int *)variables_table) + txtpos[-1] - 'A'; 
-						*varaddr = *varaddr + f->step;
-						/* Use a different test depending on the sign of the step increment */
-						if((f->step > 0 && *varaddr <= f->terminal) || (f->step < 0 && *varaddr >= f->terminal))
-						{
-							/* We have to loop so don't pop the stack */
-							txtpos = f->sff_txtpos;
-							current_line = f->sff_current_line;
-							sp = tempsp; /* SMBAKER: pop any stack pointers for inner loops */
-							goto run_next_statement;
-						}
-						/* We've run to the end of the loop. drop out of the loop, popping the stack */
-						sp = tempsp + sizeof(struct stack_for_frame);
-						goto run_next_statement;
-					}
-				}
-				/* This is not the loop you are looking for... so Walk back up the stack */
-				tempsp += sizeof(struct stack_for_frame);
-				break;
-			default:
-				goto stackstuffed;
-		}
-	}
-	/* Didn't find the variable we've been looking for */
-	goto syntaxerror;
-
-assignment:
-	{
-		short int value;
-		short int *var;
-
-		if(*txtpos < 'A' || *txtpos > 'Z')
-			goto syntaxerror;
-
-    /* array assignment */
-    if(*(txtpos+1) == '(') {
-			unsigned int arr_ofs = ((short int *)array_table)[*txtpos - 'A'];
-			unsigned int arr_siz = ((short int *)array_sz)[*txtpos - 'A'];
-			unsigned int index;
-			txtpos++; /* now pointing at the paren */
-			index = expr2();
-			if ((index <0 ) || (index>=arr_siz)) {
-				printmsg(boundsmsg);
-				goto invalidexpr;
-			}
-			var = (short int *) (memory + arr_ofs + index*VAR_SIZE);
-			goto asg_var;
-		}
-
-		var = (short int *)variables_table + *txtpos - 'A';
-		txtpos++;
-
-asg_var:
-		ignore_blanks();
-
-		if (*txtpos != '=')
-			goto syntaxerror;
-		txtpos++;
-		ignore_blanks();
-		exp_error = 0;
-		value = expression();
-		if(exp_error)
-			goto invalidexpr;
-		/* Check that we are at the end of the statement */
-		if(!check_statement_end())
-			goto syntaxerror;
-		*var = value;
-	}
-	goto run_next_statement;
-
-sleep:
-        {
-                short int value;
-                exp_error = 0;
-		value = expression();
-		if(exp_error)
-  	            goto invalidexpr;
-                /* delay(value); */
-        }
-        goto run_next_statement;
-
-do_clear:
-  clear();
-	goto run_next_statement;
-
-do_dim:
-  {
-		uchar varnum;
-		unsigned int arrsize;
-    if(*txtpos < 'A' || *txtpos > 'Z')
-	    goto syntaxerror;
-		varnum = *txtpos - 'A';
-		txtpos++;
-
-		ignore_blanks();
-		if (*txtpos != '(')
-		  goto syntaxerror;
-
-		arrsize = expression();
-		dim(varnum, arrsize+1);
-		if(!check_statement_end())
-			goto syntaxerror;
-
-		goto run_next_statement;
-	}
-
-do_poke:
-	{
-		short int value;
-		uchar *address;
-
-		/* Work out where to put it */
-		exp_error = 0;
-		value = expression();
-		if(exp_error)
-			goto invalidexpr;
-		address = (uchar *)value;
-
-		/* check for a comma */
-		ignore_blanks();
-		if (*txtpos != ',')
-			goto syntaxerror;
-		txtpos++;
-		ignore_blanks();
-
-		/* Now get the value to assign */
-		exp_error = 0;
-		value = expression();
-		if(exp_error)
-			goto invalidexpr;
-		poke(address, (uchar) value);
-		/* Check that we are at the end of the statement */
-		if(!check_statement_end())
-			goto syntaxerror;
-	}
-	goto run_next_statement;
-
-do_outp:
-	{
-		short int value;
-		uchar *address;
-
-		/* Work out where to put it */
-		exp_error = 0;
-		value = expression();
-		if(exp_error)
-			goto invalidexpr;
-		address = (uchar *)value;
-
-		/* check for a comma */
-		ignore_blanks();
-		if (*txtpos != ',')
-			goto syntaxerror;
-		txtpos++;
-		ignore_blanks();
-
-		/* Now get the value to assign */
-		exp_error = 0;
-		value = expression();
-		if(exp_error)
-			goto invalidexpr;
-		outp(address, (uchar) value);
-		/* Check that we are at the end of the statement */
-		if(!check_statement_end())
-			goto syntaxerror;
-	}
-	goto run_next_statement;	
-
-list:
-	linenum = testnum(); /* Retuns 0 if no line found. */
-
-	/* Should be EOL */
-	if(txtpos[0] != NL)
-		goto syntaxerror;
-
-	printpgm(linenum);
-	goto warmstart;
-
-save:
-  if (!get_quoted_string(fn))
-	  goto syntaxerror;
-	if (!open_write(fn)) 
-	  goto ioerror;
-  printpgm(0);
-	close_file();
-	goto warmstart;
-
-load:
-  if (!get_quoted_string(fn))
-	  goto syntaxerror;
-	if (!open_read(fn))
-	  goto ioerror;
-  loadpgm();
-	close_file();
-	goto warmstart;
-
-print:
-	/* If we have an empty list then just put out a NL */
-	if(*txtpos == ':' )
-	{
-        put_nl();
-		txtpos++;
-		goto run_next_statement;
-	}
-	if(*txtpos == NL)
-	{
-		goto execnextline;
-	}
-
-	while(1)
-	{
-		ignore_blanks();
-		if(print_quoted_string())
-		{
-			;
-		}
-		else if(*txtpos == '"' || *txtpos == '\'')
-			goto syntaxerror;
-		else
-		{
-			short int e;
-			exp_error = 0;
-			e = expression();
-			if(exp_error)
-				goto invalidexpr;
-			printnum(e);
-		}
-
-		/* At this point we have three options, a comma or a new line */
-		if(*txtpos == ',')
-			txtpos++;	/* Skip the comma and move onto the next */
-		else if(txtpos[0] == ';' && (txtpos[1] == NL || txtpos[1] == ':'))
-		{
-			txtpos++; /* This has to be the end of the print - no newline */
-			break;
-		}
-		else if(check_statement_end())
-		{
-			put_nl();	/* The end of the print statement */
-			break;
-		}
-		else
-			goto syntaxerror;	
-	}
-	goto run_next_statement;
-}
-
-/***********************************************************/
-uchar breakcheck() {
-  if(kbhit())
-    return getch() == CTRLC;
-  else
-    return 0;
-}
-
-int main(argc, argv)
-int argc;
-char **argv;
-{
-	lecho = enable_raw_mode();
-	initialize();
-
-	if (argc>1) {
-	  if (!open_read(argv[1])) {
-			printmsg("Failed to load program\n");
-			disable_raw_mode();
-			return -1;
-		}
-    loadpgm();
-	  close_file();
-		loop(1);     /* automatically RUN */
-	} else {
-		banner();
-    loop(0);     /* don't acutomatically RUN */
-	}
-
-	disable_raw_mode();
-}
+/*  tbasic.c : An implementation of Not-So-TinyBASIC in C
+
+ Scott Baker, https://www.smbaker.com/
+
+ Supports 26 16-bit integer variables named A-Z. Also supports up
+ to 26 arrays of 16-bit integer variables also named A-Z. You can
+ have both a simple variable and an array of the same name should
+ you choose to do so (though you may confuse yourself).
+ 
+ Code is split into a host-agnostic portion (tbasic.c) and a host
+ specific version (host.c), with the intent that porting to a new
+ environement should generally only involve changes to host.c and
+ not changes to tbasic.c.
+
+ The dialect of C is an early variant of K&R, with old-style function
+ prototypes and missing some features. The code is the least common
+ denominator that should compile on old as well as new environments
+ such as Linux.
+
+ The code is very much "assembly converted to C and hacked upon by
+ each person to create features they inidividually deemed necessary".
+ It is not the quality of a green field implementation and carries
+ much baggage.
+
+ Based on Arduino Tiny Basic, by: Mike Field - hamster@snap.net.nz
+ Based on TinyBasic for 68000, by Gordon Brandly
+ (see http://members.shaw.ca/gbrandly/68ktinyb.html)
+
+ which itself was derived from Palo Alto Tiny BASIC as 
+ published in the May 1976 issue of Dr. Dobb's Journal.
+
+ 0.04 01/08/2022  : modified for CPM-8000's wonky zcc compiler
+ 								  : added hex notation &Hxx
+									: added load, save commands
+									: added DIM for dimensioning arrays
+									: added FRE() and RAND() functions
+ 
+ 0.03 21/01/2011 : Added INPUT routine 
+                 : Reorganised memory layout
+                 : Expanded all error messages
+                 : Break key added
+                 : Removed the calls to printf (left by debugging)
+
+CP/M-8000 Instructions:
+	zcc tbasic.c
+	zcc emitc.c
+	zcc ir.c
+	zcc jit.c
+	zcc host.c
+	a:asz8k -o inout.o inout.8kn
+	a:ld8k -w -s -o tbasic.z8k startup.o tbasic.o emitc.o ir.o jit.o host.o inout.o -lcpm
+
+Linux Build Instructions:
+  make
+*/
+
+#include <stdio.h>
+#include "host.h"
+#include "tbasic.h"
+
+#define MAXLINENUM 65000
+
+/* return values for procline() */
+#define PROCLINE_EOF 0
+#define PROCLINE_OKAY 1
+#define PROCLINE_DIRECT 2
+#define PROCLINE_BADLINE 3
+#define PROCLINE_DELETE 4
+#define PROCLINE_EMPTY 5
+
+/* ASCII Characters */
+#define TAB	'\t'
+#define BELL	'\b'
+#define DEL	'\177'
+#define SPACE   ' '
+#define CTRLC	0x03
+#define CTRLH	0x08
+#define CTRLS	0x13
+#define CTRLX	0x18
+
+#define debugf if (0) printf
+
+typedef unsigned short LINENUM;
+
+/***********************************************************/
+/* Keyword table and constants - the last character has 0x80 added to it */
+uchar keywords[] = {
+	'L','I','S','T'+0x80,
+	'L','O','A','D'+0x80,
+	'N','E','W'+0x80,
+	'R','U','N'+0x80,
+	'S','A','V','E'+0x80,
+	'N','E','X','T'+0x80,
+	'L','E','T'+0x80,
+	'I','F'+0x80,
+	'G','O','T','O'+0x80,
+	'G','O','S','U','B'+0x80,
+	'R','E','T','U','R','N'+0x80,
+	'R','E','M'+0x80,
+	'F','O','R'+0x80,
+	'I','N','P','U','T'+0x80,
+	'P','R','I','N','T'+0x80,
+	'P','O','K','E'+0x80,
+	'S','T','O','P'+0x80,
+	'B','Y','E'+0x80,
+	'S','Y','S','T','E','M'+0x80,    /* synonym for BYE */
+	'O','U','T'+0x80,
+  'S','L','E','E','P'+0x80,
+  'C','L','E','A','R'+0x80,
+	'D','I','M'+0x80,
+	'E','N','D'+0x80,               /* synomym for STOP but with the Break! message */
+	'D','A','T','A'+0x80,
+	'R','E','A','D'+0x80,
+	'R','E','S','T','O','R','E'+0x80,
+	'O','P','E','N'+0x80,
+	'C','L','O','S','E'+0x80,
+	'M','A','T'+0x80,
+	'S','O','R','T'+0x80,
+	'M','E','M','C','P','Y'+0x80,
+	'M','E','M','S','E','T'+0x80,
+	'R','A','N','D','O','M','I','Z','E'+0x80,
+	'R','A','N','D','F','I','L','L'+0x80,
+	'P','A','R','F','O','R'+0x80,
+	'S','T','A','T','S'+0x80,
+	0
+};
+
+#define KW_LIST		0
+#define KW_LOAD		1
+#define KW_NEW		2
+#define KW_RUN		3
+#define KW_SAVE		4
+#define KW_NEXT		5
+#define KW_LET		6
+#define KW_IF		7
+#define KW_GOTO		8
+#define KW_GOSUB	9
+#define KW_RETURN	10
+#define KW_REM		11
+#define KW_FOR		12
+#define KW_INPUT	13
+#define KW_PRINT	14
+#define KW_POKE		15
+#define KW_STOP		16
+#define KW_BYE		17
+#define KW_SYSTEM 18
+#define KW_OUT    19
+#define KW_SLEEP	20
+#define KW_CLEAR  21
+#define KW_DIM    22
+#define KW_END    23
+#define KW_DATA   24
+#define KW_READ   25
+#define KW_RESTORE 26
+#define KW_OPEN   27
+#define KW_CLOSE  28
+#define KW_MAT    29
+#define KW_SORT   30
+#define KW_MEMCPY 31
+#define KW_MEMSET 32
+#define KW_RANDOMIZE 33
+#define KW_RANDFILL 34
+#define KW_PARFOR 35
+#define KW_STATS  36
+#define KW_DEFAULT	37
+
+/* in FUNC_* order, see tbasic.h */
+uchar func_tab[] = {
+	'P','E','E','K'+0x80,
+	'A','B','S'+0x80,
+	'H','I','G','H'+0x80,
+	'L','O','W'+0x80,
+	'I','N','P'+0x80,
+	'F','R','E'+0x80,
+	'R','A','N', 'D'+0x80,
+	'E','O','F'+0x80,
+	'S','E','A','R','C','H'+0x80,
+	'M','E','M','S','U','M'+0x80,
+	'C','R','C'+0x80,
+	'S','Q','R'+0x80,
+	'S','I','N'+0x80,
+	'C','O','S'+0x80,
+	'A','T','N'+0x80,
+	0
+};
+
+uchar to_tab[] = {
+	'T','O'+0x80,
+	0
+};
+
+uchar step_tab[] = {
+	'S','T','E','P'+0x80,
+	0
+};
+
+/* OPEN "file" FOR mode AS #n */
+uchar for_tab[] = {
+	'F','O','R'+0x80,
+	0
+};
+
+uchar mode_tab[] = {
+	'I','N','P','U','T'+0x80,
+	'O','U','T','P','U','T'+0x80,
+	'A','P','P','E','N','D'+0x80,
+	0
+};
+#define MODE_INPUT 0
+#define MODE_OUTPUT 1
+#define MODE_APPEND 2
+#define MODE_UNKNOWN 3
+
+uchar as_tab[] = {
+	'A','S'+0x80,
+	0
+};
+
+uchar fill_tab[] = {
+	'F','I','L','L'+0x80,
+	0
+};
+
+uchar desc_tab[] = {
+	'D','E','S','C'+0x80,
+	0
+};
+
+uchar relop_tab[] = {
+	'>','='+0x80,
+	'<','>'+0x80,
+	'>'+0x80,
+	'='+0x80,
+	'<','='+0x80,
+	'<'+0x80,
+	0
+};
+
+#define RELOP_GE		0
+#define RELOP_NE		1
+#define RELOP_GT		2
+#define RELOP_EQ		3
+#define RELOP_LE		4
+#define RELOP_LT		5
+#define RELOP_UNKNOWN	        6
+
+uchar logop_tab[] = {
+	'A','N','D'+0x80,
+	'O','R'+0x80,
+	'X','O','R'+0x80,
+	0
+};
+
+#define LOGOP_AND   0
+#define LOGOP_OR    1
+#define LOGOP_XOR   2
+#define LOGOP_UNKNOWN 3
+
+uchar not_tab[] = {
+	'N','O','T'+0x80,
+	0
+};
+
+uchar shift_tab[] = {
+	'S','H','L'+0x80,
+	'S','H','R'+0x80,
+	0
+};
+
+#define SHIFT_LEFT  0
+#define SHIFT_RIGHT 1
+#define SHIFT_UNKNOWN 2
+
+#define NUM_VAR 27  /* why is this 27 and not 26 ?? */
+#define VAR_SIZE sizeof(short int) /* Size of variables in bytes */
+
+char fn[FNSIZE]; /* filename buffer */
+uchar *txtpos, *list_line;
+uchar exp_error;
+uchar exp_cmp;    /* the value just parsed came from a comparison, so is 1 or 0 */
+uchar *tempsp;
+uchar *stack_limit;
+uchar *pgm_start;
+uchar *pgm_end;
+uchar *image_end; /* end of the run image built above the program; free memory starts here */
+uchar *stack; /* Software stack for things that should go on the CPU stack */
+uchar *variables_table;
+uchar *array_table;
+uchar *array_sz;
+uchar *array_esz;  /* bytes per element: 2, or 1 for a DIM A%() byte array */
+uchar *array_cols; /* row length of a DIM A(h,w) array, 0 if one dimension */
+uchar *current_line;
+uchar *sp;
+uchar *top_sp; /* points to the top of the stack */
+uchar table_index;
+LINENUM linenum;
+
+/* The run image. At RUN the values of all DATA statements are parsed
+ * into a pool of words just above the program, followed by an index of
+ * (line number, pool offset) pairs, one per DATA line, for RESTORE.
+ * Editing the program throws the image away.
+ */
+#define MINFREE 64  /* memory kept free between the run image and the stack */
+#define LINEBUF (image_end+sizeof(LINENUM)) /* where getln() puts typed lines */
+uchar image_ok;
+short int *data_pool;
+unsigned short *data_index;
+unsigned short data_count;
+unsigned short data_lines;
+unsigned short data_ptr;  /* next pool entry for READ */
+
+uchar lecho;
+uchar at_eof;  /* getln() has seen the end of input */
+uchar exit_code;
+
+/* Per-run quotas, for running untrusted programs. A budget of 0 means
+ * unlimited. The statement loop only decrements quota_tick; the budget
+ * and the clock are looked at once every QUOTA_SPAN statements.
+ */
+#define QUOTA_SPAN 4096
+#define EXIT_STMTLIMIT 2
+#define EXIT_TIMELIMIT 3
+long stmt_budget;  /* statements allowed per run */
+long time_limit;   /* milliseconds allowed per run */
+long stmt_left;    /* statements not yet handed out to quota_tick */
+long run_start;    /* host_millis() when the run started */
+int quota_tick;    /* statements left before the next quota_check() */
+const uchar *quota_msg;
+uchar no_jit;      /* -J, or a quota: never run loops as machine code */
+uchar no_ir;       /* -I, or a quota: never run the compiled form */
+uchar ir_verbose;  /* -v: report what the optimizer did at RUN */
+char *prof_file;   /* -p: where to write the profile at exit, or 0 */
+uchar stats_exit;  /* -S: show STATS at exit */
+uchar stats_run;   /* this run is interpreted so STATS counts every statement */
+
+/* What the interpreter has been doing since the last RUN, for STATS.
+ * Statements run as machine code, or inside a superinstruction or a
+ * vectorized loop of ir.c, aren't counted one by one.
+ */
+#ifndef NOSTATS
+long stat_stmts;       /* statements started */
+long stat_finds;       /* findline() calls */
+long stat_lines;       /* lines findline() stepped past */
+long stat_scans;       /* characters scantable() compared */
+long stat_frames;      /* stack frames find_frame() looked at */
+long stat_ports;       /* INP() and OUT */
+long stat_kw[KW_DEFAULT+1];  /* statements started, by keyword */
+unsigned short stat_peak;  /* most bytes of stack in use */
+uchar stats_part;  /* the compiled form or machine code ran uncounted */
+uchar cmp_stats;   /* compile() has met a STATS */
+uchar stats_next;  /* a STATS was typed: interpret the next run */
+#endif
+
+const uchar iomsg[] = "IO Error";
+const uchar okmsg[]		= "OK";
+const uchar badlinemsg[]		= "Invalid line number";
+const uchar invalidexprmsg[] = "Invalid expression";
+const uchar syntaxmsg[] = "Syntax Error";
+const uchar badinputmsg[] = "\nBad number";
+const uchar boundsmsg[] = "Bounds error";
+const uchar nodatamsg[] = "Out of data";
+const uchar eofmsg[] = "End of file";
+const uchar nomemmsg[]	= "Not enough memory!";
+const uchar initmsg[]	= "Z8000 TinyBasic, www.smbaker.com";
+const uchar memorymsg[]	= " bytes free.";
+const uchar breakmsg[]	= "break!";
+const uchar stackstuffedmsg[] = "Stack is stuffed!\n";
+const uchar unimplimentedmsg[]	= "Unimplemented";
+const uchar backspacemsg[]		= "\b \b";
+const uchar stmtlimitmsg[] = "Statement limit exceeded";
+const uchar timelimitmsg[] = "Time limit exceeded";
+const uchar sharedmsg[] = "Shared variable set in PARFOR";
+const uchar parbodymsg[] = "Statement not allowed in PARFOR";
+const uchar usagemsg[] = "usage: tbasic [-a] [-R] [-s statements] [-t seconds] [-I] [-J] [-v] [-S] [-p profile] [-z] [-Z costs] [-T trace] [-P trace] [--emit-c] [program.bas]";
+
+short int expression();
+uchar breakcheck();
+short int getarray();
+short int *arrptr();
+short int elem_get();
+/***************************************************************************/
+voidret ignore_blanks()
+{
+	while(*txtpos == SPACE || *txtpos == TAB)
+		txtpos++;
+}
+
+/* zcc does not support "unsigned char" */
+#define SIGNCONV(x) (((x)<0) ? (256+(x)) : (x))
+
+/* zcc does not like word writes that are at odd addresses. Write it as two
+ * bytes instead.
+ */
+voidret encode_linenum(s, linenum)
+uchar *s;
+unsigned short linenum;
+{
+	*s = linenum >> 8;
+	*(s+1) = linenum & 0xFF;
+	/* *((unsigned short *)s) = linenum; */
+}
+
+/* see encode_linenum for explanation */
+unsigned short decode_linenum(s)
+uchar *s;
+{
+	return (SIGNCONV(*s) << 8) + SIGNCONV(*(s+1));
+	/* return *((LINENUM *)(s)); */
+}
+
+/***************************************************************************/
+voidret scantable(table)
+uchar *table;
+{
+	int i = 0;
+	ignore_blanks();
+	table_index = 0;
+	while(1)
+	{
+		/* Run out of table entries? */
+		if(table[0] == 0)
+      return 0;
+		STAT(stat_scans++);
+
+		/* Do we match this character? */
+		if(txtpos[i] == table[0])
+		{
+			i++;
+			table++;
+		}
+		else
+		{
+			/* do we match the last character of keyword (with 0x80 added)? If so, return */
+			if(txtpos[i]+0x80 == SIGNCONV(table[0]))
+			{
+				txtpos += i+1;  /* Advance the pointer to following the keyword */
+				ignore_blanks();
+				return 0;
+			}
+
+			/* Forward to the end of this keyword */
+			while((SIGNCONV(table[0]) & 0x80) == 0)
+				table++;
+
+			/* Now move on to the first character of the next word, and reset the position index */
+			table++;
+			table_index++;
+			i = 0;
+		}
+	}
+}
+
+/***************************************************************************/
+voidret pushb(b)
+uchar b;
+{
+	sp--;
+	*sp = b;
+}
+
+/***************************************************************************/
+uchar popb()
+{
+	uchar b;
+	b = *sp;
+	sp++;
+	return b;
+}
+
+/***************************************************************************/
+voidret printnum(num)
+int num;
+{
+	int digits = 0;
+
+	if(num < 0)
+	{
+		num = -num;
+		putch('-');
+	}
+
+	do {
+		pushb(num%10+'0');
+		num = num/10;
+		digits++;
+	}
+	while (num > 0);
+
+	while(digits > 0)
+	{
+		putch(popb());
+		digits--;
+	}
+}
+/***************************************************************************/
+unsigned short testnum()
+{
+	unsigned short num = 0;
+	ignore_blanks();
+	
+	while(*txtpos>= '0' && *txtpos <= '9' )
+	{
+		/* Trap overflows */
+		if(num >= MAXLINENUM) /* was 0xFFFF/10, but this seems to be miscomputed in zcc */
+		{
+			num = 0xFFFF;
+			break;
+		}
+
+		num = num *10 + *txtpos - '0';
+		txtpos++;
+	}
+	return	num;
+}
+
+/***************************************************************************/
+uchar check_statement_end()
+{
+	ignore_blanks();
+	return (*txtpos == NL) || (*txtpos == ':');
+}
+
+/***************************************************************************/
+voidret printnnl(msg)
+const uchar *msg;
+{
+	while(*msg)
+	{
+		putch(*msg);
+		msg++;
+	}
+}
+
+/***************************************************************************/
+uchar print_quoted_string()
+{
+	int i=0;
+	uchar delim = *txtpos;
+	if(delim != '"' && delim != '\'')
+		return 0;
+	txtpos++;
+
+	/* Check we have a closing delimiter */
+	while(txtpos[i] != delim)
+	{
+		if(txtpos[i] == NL)
+			return 0;
+		i++;
+	}
+
+	/* Print the characters */
+	while(*txtpos != delim)
+	{
+		putch(*txtpos);
+		txtpos++;
+	}
+	txtpos++; /* Skip over the last delimiter */
+	ignore_blanks();
+
+	return 1;
+}
+
+/***************************************************************************/
+uchar get_quoted_string(dest)
+char *dest;
+{
+	int i=0;
+	int maxlen=FNSIZE-1;
+	uchar delim = *txtpos;
+	if(delim != '"' && delim != '\'')
+		return 0;
+	txtpos++;
+
+	/* Check we have a closing delimiter */
+	while(txtpos[i] != delim)
+	{
+		if(txtpos[i] == NL)
+			return 0;
+		i++;
+	}
+
+	/* Print the characters */
+	while(*txtpos != delim)
+	{
+    if (maxlen<=0) {
+			return 0; /* complain */
+		}
+
+		*dest = *txtpos;
+		dest++;
+		txtpos++;
+		maxlen--;
+	}
+	txtpos++; /* Skip over the last delimiter */
+	ignore_blanks();
+
+	*dest = '\0';
+
+	return 1;
+}
+
+/***************************************************************************/
+voidret printmsg(msg)
+const uchar *msg;
+{
+	printnnl(msg);
+  put_nl();
+}
+
+/***************************************************************************/
+uchar getln(prompt)
+char prompt;
+{
+	if (prompt) {
+	  putch(prompt);
+	}
+	flush_output();
+	txtpos = LINEBUF;
+
+	while(1)
+	{
+		char c;
+		int n;
+
+		/* take ordinary characters a block at a time */
+		n = getchunk(txtpos, (sp-2) - txtpos);
+		if (n > 0) {
+			if (lecho) {
+				int i;
+				for (i=0; i<n; i++)
+					putch(txtpos[i]);
+			}
+			txtpos += n;
+		}
+
+		c = getch();
+		switch(c)
+		{
+			case EOFC:
+				/* end of input with nothing typed */
+				if (txtpos == LINEBUF) {
+					at_eof = 1;
+					return 0;
+				}
+				/* fallthrough */
+			case CR:
+			case NL:
+			  if (lecho) {
+          put_nl();
+				}
+				/* Terminate all strings with a NL */
+				txtpos[0] = NL;
+				return 1;
+			case CTRLC:
+				return 0;
+			case CTRLH:
+			case DEL:
+				if(txtpos == image_end)
+					break;
+				txtpos--;
+				printnnl(backspacemsg);
+				break;
+			default:
+				/* We need to leave at least one space to allow us to shuffle the line into order */
+				if(txtpos == sp-2)
+					putch(BELL);
+				else
+				{
+					txtpos[0] = c;
+					txtpos++;
+					if (lecho)
+					  putch(c);
+				}
+		}
+	}
+}
+
+/***************************************************************************/
+uchar *findline()
+{
+	uchar *line = pgm_start;
+	STAT(stat_finds++);
+	while(1)
+	{
+		if(line == pgm_end) {
+			return line;
+		}
+
+		if (decode_linenum(line) >= linenum) {
+			return line;
+		}
+
+		/* Add the line length onto the current address, to get to the next line; */
+		line += line[sizeof(LINENUM)];
+		STAT(stat_lines++);
+	}
+}
+
+/***************************************************************************/
+voidret toUppercaseBuffer()
+{
+	uchar *c = LINEBUF;
+	uchar quote = 0;
+
+	while(*c != NL)
+	{
+		/* Are we in a quoted string? */
+		if(*c == quote)
+			quote = 0;
+		else if(*c == '"' || *c == '\'')
+			quote = *c;
+		else if(quote == 0 && *c >= 'a' && *c <= 'z')
+			*c = *c + 'A' - 'a';
+		c++;
+	}
+}
+
+/***************************************************************************/
+voidret printline()
+{
+	LINENUM line_num;
+
+	line_num = decode_linenum(list_line);
+	
+  list_line += sizeof(LINENUM) + sizeof(char);
+
+	/* Output the line */
+	printnum(line_num);
+	putch(' ');
+	while(*list_line != NL) {
+		putch(*list_line);
+		list_line++;
+	}
+	list_line++;
+	put_nl();
+}
+
+voidret printpgm(linestart)
+unsigned short linestart;
+{
+	list_line = findline();
+	while(list_line != pgm_end) {
+      printline();
+	}
+}
+
+/* esz is the element size, VAR_SIZE or 1 for a byte array. cols is the
+ * row length of a two-dimensional array, stored row-major, or 0.
+ * returns 0 if there isn't enough memory for the array
+ */
+uchar dim(name, size, esz, cols)
+uchar name;
+unsigned short size;
+uchar esz;
+unsigned short cols;
+{
+	unsigned int i;
+	unsigned short arr_start;
+	long bytes;
+
+	bytes = (long)size*esz;
+	if (((short int *)array_esz)[name] == esz && ((short int *)array_sz)[name] >= size) {
+		/* use existing array */
+    arr_start = ((short int *)array_table)[name];
+	} else {
+		/* new array, or expanded array */
+		/* note: expanding array will cause loss of space */
+		if (bytes > (top_sp - image_end) - MINFREE)
+			return 0;
+	  top_sp = top_sp - bytes;
+		if ((top_sp - memory) & 1)
+			top_sp--;  /* keep the stack and word arrays at even addresses */
+	  sp = top_sp;
+	  arr_start = top_sp-memory;
+	}
+
+  /* clear the array */
+	for (i=0; i<bytes; i++) {
+		memory[arr_start+i] = 0;
+	}
+
+	((short int *)array_table)[name] = arr_start;
+	((short int *)array_sz)[name] = size;
+	((short int *)array_esz)[name] = esz;
+	((short int *)array_cols)[name] = cols;
+	jit_reset();
+	return 1;
+}
+
+/***************************************************************************/
+/* sift a[root] down a heap of n words; desc builds a min-heap */
+voidret siftdown(a, root, n, desc)
+short int *a;
+unsigned int root;
+unsigned int n;
+uchar desc;
+{
+	unsigned int child;
+	short int t;
+
+	while((child = 2*root+1) < n)
+	{
+		if(child+1 < n && (desc ? a[child+1] < a[child] : a[child] < a[child+1]))
+			child++;
+		if(!(desc ? a[child] < a[root] : a[root] < a[child]))
+			return 0;
+		t = a[root];
+		a[root] = a[child];
+		a[child] = t;
+		root = child;
+	}
+}
+
+/* heapsort n words in place, ascending or (desc) descending */
+voidret sort_words(a, n, desc)
+short int *a;
+unsigned int n;
+uchar desc;
+{
+	unsigned int i;
+	short int t;
+
+	if(n < 2)
+		return 0;
+	for(i = n/2; i > 0; i--)
+		siftdown(a, i-1, n, desc);
+	for(i = n-1; i > 0; i--)
+	{
+		t = a[0];
+		a[0] = a[i];
+		a[i] = t;
+		siftdown(a, 0, i, desc);
+	}
+}
+
+/* counting sort of n byte array elements, which hold 0 to 255 */
+voidret sort_bytes(a, n, desc)
+uchar *a;
+unsigned int n;
+uchar desc;
+{
+	unsigned int count[256];
+	unsigned int i, j;
+
+	for(i=0; i<256; i++)
+		count[i] = 0;
+	for(i=0; i<n; i++)
+		count[SIGNCONV(a[i])]++;
+	for(i=0; i<256; i++)
+	{
+		j = desc ? 255-i : i;
+		while(count[j]--)
+			*a++ = j;
+	}
+}
+
+/* Binary search of the first n elements of sorted array name for v.
+ * Works on ascending or descending order, judged by the first and last
+ * element. Returns the index of the first match, or -1.
+ */
+short int search_elems(name, n, v)
+short int name;
+unsigned int n;
+short int v;
+{
+	unsigned int lo = 0;
+	unsigned int hi = n;
+	unsigned int mid;
+	uchar desc;
+
+	if(n == 0)
+		return -1;
+	desc = elem_get(name, 0) > elem_get(name, n-1);
+	while(lo < hi)
+	{
+		mid = lo + (hi-lo)/2;
+		if(desc ? elem_get(name, mid) > v : elem_get(name, mid) < v)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	if(lo < n && elem_get(name, lo) == v)
+		return lo;
+	return -1;
+}
+
+/* Parse n comma separated expressions and the closing paren of a
+ * function call into args. Returns 0 on a syntax or expression error.
+ */
+uchar getargs(args, n)
+short int *args;
+int n;
+{
+	int i;
+
+	for(i=0; i<n; i++)
+	{
+		if(i > 0)
+		{
+			if(*txtpos != ',')
+				return 0;
+			txtpos++;
+		}
+		args[i] = expression();
+		if(exp_error)
+			return 0;
+	}
+	if(*txtpos != ')')
+		return 0;
+	txtpos++;
+	return 1;
+}
+
+/* the arguments of SEARCH(A, n, value), txtpos just past the paren */
+short int search_call()
+{
+	short int name;
+	unsigned short n;
+	short int v;
+
+	name = getarray();
+	if(name < 0 || *txtpos != ',')
+		goto search_error;
+	txtpos++;
+	n = expression();
+	if(exp_error || *txtpos != ',')
+		goto search_error;
+	txtpos++;
+	v = expression();
+	if(exp_error || *txtpos != ')')
+		goto search_error;
+	txtpos++;
+	return search_run(name, n, v);
+
+search_error:
+	exp_error = 1;
+	return 0;
+}
+
+/* SEARCH() once its arguments are known */
+short int search_run(name, n, v)
+short int name;
+unsigned short n;
+short int v;
+{
+	if(n > ((unsigned short *)array_sz)[name]) {
+		printmsg(boundsmsg);
+		exp_error = 1;
+		return 0;
+	}
+	return search_elems(name, n, v);
+}
+
+/***************************************************************************/
+/* Fixed point math. Angles are whole degrees and sines, cosines and
+ * tangents are scaled by 16384 (ONE_Q14), so SIN(30) is 8192.
+ */
+
+/* sin of 0 to 90 degrees, Q14 */
+short int sin_tab[] = {
+	0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+	2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+	5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+	8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+	10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+	12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+	14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+	15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+	16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+	16384
+};
+
+short int sin_deg(d)
+short int d;
+{
+	d = d % 360;
+	if(d < 0)
+		d += 360;
+	if(d <= 90)
+		return sin_tab[d];
+	if(d <= 180)
+		return sin_tab[180-d];
+	if(d <= 270)
+		return -sin_tab[d-180];
+	return -sin_tab[360-d];
+}
+
+/* how far angle d is from the direction (x,y), for 0 <= d <= 90 and
+ * x, y >= 0: |sin(d-angle)| scaled by the length of (x,y)
+ */
+long atn_err(d, x, y)
+short int d;
+long x;
+long y;
+{
+	long e = sin_tab[d]*x - sin_tab[90-d]*y;
+	return e < 0 ? -e : e;
+}
+
+/* the angle of the point (x,y) in degrees, -180 to 180, rounded */
+short int atn_deg(y, x)
+short int y;
+short int x;
+{
+	long ax = x < 0 ? -(long)x : x;
+	long ay = y < 0 ? -(long)y : y;
+	short int lo = 0;
+	short int hi = 90;
+	short int mid;
+
+	/* find the first whole degree at or past the angle, then take
+	 * whichever of it and the one before is nearer
+	 */
+	while(lo < hi)
+	{
+		mid = (lo+hi)/2;
+		if(sin_tab[mid]*ax < sin_tab[90-mid]*ay)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	if(lo > 0 && atn_err(lo-1, ax, ay) <= atn_err(lo, ax, ay))
+		lo--;
+	if(x < 0)
+		lo = 180-lo;
+	return y < 0 ? -lo : lo;
+}
+
+/* integer square root, rounded down */
+short int isqrt(n)
+unsigned short n;
+{
+	unsigned short root = 0;
+	unsigned short bit = 0x4000;
+
+	while(bit > n)
+		bit >>= 2;
+	while(bit)
+	{
+		if(n >= root+bit)
+		{
+			n -= root+bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+		bit >>= 2;
+	}
+	return root;
+}
+
+/***************************************************************************/
+/* Parse the index of array name with txtpos on the letter: (i), or (i,j)
+ * for a DIM A(h,w) array, which is stored row-major so that element i,j
+ * is at i*(w+1)+j. A single index addresses a two-dimensional array as
+ * one flat row. Returns the element number, or -1 with exp_error set.
+ */
+short int arr_index(name)
+uchar name;
+{
+	unsigned int siz = ((short int *)array_sz)[name];
+	unsigned int cols = ((short int *)array_cols)[name];
+	unsigned int i, j;
+
+	txtpos += 2; /* skip the name and the paren */
+	i = expression();
+	if (exp_error)
+		return -1;
+	if (*txtpos == ',') {
+		txtpos++;
+		j = expression();
+		if (exp_error)
+			return -1;
+		if (cols == 0 || i >= siz/cols || j >= cols)
+			goto bounds;
+		i = i*cols + j;
+	}
+	else if (i >= siz)
+		goto bounds;
+	if (*txtpos != ')') {
+		exp_error = 1;
+		return -1;
+	}
+	txtpos++;
+	ignore_blanks();
+	return i;
+
+bounds:
+	printmsg(boundsmsg);
+	exp_error = 1;
+	return -1;
+}
+
+/***************************************************************************/
+/* The native calls in the program text, by offset, so that the registry
+ * is searched for the name at each one only the first time it runs.
+ */
+#define NATIVE_SITES 64
+unsigned short native_site[NATIVE_SITES];  /* 1 + offset of the name, or 0 */
+uchar native_idx[NATIVE_SITES];
+uchar native_len[NATIVE_SITES];
+
+/* native_match() for the name at txtpos */
+int native_at()
+{
+	uchar *name = txtpos;
+	unsigned short at;
+	int h;
+	int n;
+
+	if(txtpos < pgm_start || txtpos >= pgm_end)
+		return native_match(&txtpos);  /* a typed line */
+	at = txtpos - pgm_start + 1;
+	h = at % NATIVE_SITES;
+	if(native_site[h] == at) {
+		txtpos += native_len[h];
+		return native_idx[h];
+	}
+	n = native_match(&txtpos);
+	if(n >= 0) {
+		native_site[h] = at;
+		native_idx[h] = n;
+		native_len[h] = txtpos - name;
+	}
+	return n;
+}
+
+/***************************************************************************/
+/* value of a hex digit, or -1 */
+int hexdigit(c)
+uchar c;
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+/* a decimal or &H hex number at txtpos, for expr4() and c_expr4().
+ * Returns 1 with txtpos past it, or 0 if there isn't one.
+ */
+uchar number_at(val)
+short int *val;
+{
+	short int a = 0;
+
+	if(*txtpos == '0') {
+		txtpos++;
+		*val = 0;
+		return 1;
+	}
+	if(*txtpos >= '1' && *txtpos <= '9')
+	{
+		do 	{
+			a = a*10 + *txtpos - '0';
+			txtpos++;
+		} while(*txtpos >= '0' && *txtpos <= '9');
+		*val = a;
+		return 1;
+	}
+	if(txtpos[0] == '&' && (txtpos[1] == 'H' || txtpos[1] == 'h'))
+	{
+		txtpos += 2;
+		while(hexdigit(*txtpos) >= 0) {
+			a = a*16 + hexdigit(*txtpos);
+			txtpos++;
+		}
+		*val = a;
+		return 1;
+	}
+	return 0;
+}
+
+/***************************************************************************/
+short int expr4()
+{
+	uchar f;
+	short int a = 0;
+	short int b = 0;
+
+	ignore_blanks(); /* smbaker */
+
+  /* is it a decimal or hexadecimal number */
+	if(number_at(&a))
+		goto success;
+
+	/* Is it a function or variable reference? */
+	if(txtpos[0] >= 'A' && txtpos[0] <= 'Z')
+	{
+		/* is it an array reference */
+		if (txtpos[1]=='(') {
+			unsigned int arr_ofs = ((short int *)array_table)[*txtpos - 'A'];
+			uchar arr_esz = ((short int *)array_esz)[*txtpos - 'A'];
+			short int index;
+			index = arr_index(*txtpos - 'A');
+			if (index < 0)
+				goto expr4_error;
+			if (arr_esz == 1)
+				a = SIGNCONV(memory[arr_ofs+index]);
+			else
+				a = ((short int *) (memory+arr_ofs))[index];
+			goto success;
+		}
+
+		/* Is it a variable reference (single alpha) */
+		if(txtpos[1] < 'A' || txtpos[1] > 'Z')
+		{
+			a = ((short int *)variables_table)[*txtpos - 'A'];
+			txtpos++;
+			goto success;
+		}
+
+		/* Is it a function with a single parameter */
+		scantable(func_tab);
+		if(table_index == FUNC_UNKNOWN) {
+			/* a native function registered by the host */
+			short int args[NATIVE_ARGS];
+			int n;
+
+			n = native_at();
+			if(n < 0)
+				goto expr4_error;
+			ignore_blanks();
+			if(*txtpos != '(')
+				goto expr4_error;
+			txtpos++;
+			if(!getargs(args, native_arity[n]))
+				goto expr4_error;
+			a = native_call(n, args);
+			goto success;
+		}
+
+		f = table_index;
+
+		/* Pseudo Functions added by DCJ for things that need no parms */
+		if (f == FUNC_HIGH) {
+			a=1;
+			goto success;
+		}
+		if (f == FUNC_LOW) {
+			a=0;
+			goto success;
+		}
+
+		if(*txtpos != '(')
+			goto expr4_error;
+
+		txtpos++;
+		if (f == FUNC_SEARCH) {
+			a = search_call();
+			goto success;
+		}
+		if (f == FUNC_MEMSUM || f == FUNC_CRC) {
+			short int args[2];
+			if (!getargs(args, 2))
+				goto expr4_error;
+			if (!mem_range(args[0], args[1])) {
+				printmsg(boundsmsg);
+				goto expr4_error;
+			}
+			if (f == FUNC_MEMSUM)
+				a = mem_sum(args[0], args[1]);
+			else
+				a = mem_crc(args[0], args[1]);
+			goto success;
+		}
+		if (f == FUNC_ATN) {
+			/* ATN(t) of a Q14 tangent, or ATN(y,x) of a point */
+			a = expression();
+			b = ONE_Q14;
+			if (*txtpos == ',') {
+				txtpos++;
+				b = expression();
+			}
+			if (*txtpos != ')')
+				goto expr4_error;
+			txtpos++;
+			a = atn_deg(a, b);
+			goto success;
+		}
+		a = expression();
+		if(*txtpos != ')')
+				goto expr4_error;
+		txtpos++;
+		switch(f)
+		{
+			case FUNC_PEEK:
+			  a = peek(a);
+				goto success;
+			case FUNC_ABS:
+				if(a < 0)
+					a = -a;
+				goto success;
+			case FUNC_INP:
+			  a = host_inp(a);
+				STAT(stat_ports++);
+				goto success;
+			case FUNC_FRE:
+			  a = sp-image_end;
+				goto success;
+			case FUNC_RAND:
+			  a = rand(a);
+				goto success;
+			case FUNC_EOF:
+				a = chan_eof(a);
+				goto success;
+			case FUNC_SQR:
+				if(a < 0)
+					goto expr4_error;
+				a = isqrt(a);
+				goto success;
+			case FUNC_SIN:
+				a = sin_deg(a);
+				goto success;
+			case FUNC_COS:
+				a = sin_deg(a % 360 + 90);
+				goto success;
+		}
+	}
+
+	if(*txtpos == '(')
+	{
+		txtpos++;
+		a = expression();
+		if(*txtpos != ')')
+			goto expr4_error;
+
+		txtpos++;
+		ignore_blanks();
+		return a;  /* exp_cmp as the expression left it */
+	}
+
+expr4_error:
+	exp_error = 1;
+
+success:
+	exp_cmp = 0;
+	ignore_blanks();
+	return a;
+}
+
+/***************************************************************************/
+short int expr3()
+{
+	short int a,b;
+
+	a = expr4();
+	while(1)
+	{
+		if(*txtpos == '*') {
+			txtpos++;
+			b = expr4();
+			a *= b;
+			exp_cmp = 0;
+		}
+		else if(*txtpos == '/') {
+			txtpos++;
+			b = expr4();
+			if(b != 0)
+				a /= b;
+			else
+				exp_error = 1;
+			exp_cmp = 0;
+		} else if (*txtpos == 'M' && *(txtpos+1)=='O' && *(txtpos+2)=='D') {
+			txtpos++;
+			txtpos++;
+			txtpos++;
+			b=expr4();
+			if(b != 0)
+				a = a % b;
+			else
+				exp_error = 1;
+			exp_cmp = 0;
+		}
+		else
+			return a;
+	}
+}
+
+/***************************************************************************/
+short int expr2()
+{
+	short int a,b;
+
+	if(*txtpos == '-' || *txtpos == '+')
+		a = 0;
+	else
+		a = expr3();
+
+	while(1)
+	{
+		if(*txtpos == '-')
+		{
+			txtpos++;
+			b = expr3();
+			a -= b;
+			exp_cmp = 0;
+		}
+		else if(*txtpos == '+')
+		{
+			txtpos++;
+			b = expr3();
+			a += b;
+			exp_cmp = 0;
+		}
+		else
+			return a;
+	}
+}
+
+/***************************************************************************/
+/* SHL and SHR bind looser than + and -, so A SHL 2+1 shifts by 3. SHR is
+ * a logical shift; shifts of 16 or more give 0.
+ */
+short int exprshift()
+{
+	short int a,b;
+	uchar op;
+
+	a = expr2();
+	while(1)
+	{
+		if(exp_error)	return a;
+
+		scantable(shift_tab);
+		if(table_index == SHIFT_UNKNOWN)
+			return a;
+
+		op = table_index;
+		b = expr2();
+		if(b < 0 || b > 15)
+			a = 0;
+		else if(op == SHIFT_LEFT)
+			a = (unsigned short)a << b;
+		else
+			a = (unsigned short)a >> b;
+		exp_cmp = 0;
+	}
+}
+
+/***************************************************************************/
+short int expr1()
+{
+	short int a,b;
+	uchar op;
+
+	a = exprshift();
+	/* Check if we have an error */
+	if(exp_error)	return a;
+
+	scantable(relop_tab);
+	if(table_index == RELOP_UNKNOWN)
+		return a;
+	
+	op = table_index;
+	b = exprshift();
+	exp_cmp = 1;
+	switch(op)
+	{
+	case RELOP_GE:
+		return a >= b;
+	case RELOP_NE:
+		return a != b;
+	case RELOP_GT:
+		return a > b;
+	case RELOP_EQ:
+		return a == b;
+	case RELOP_LE:
+		return a <= b;
+	case RELOP_LT:
+		return a < b;
+	}
+	return 0;
+}
+
+/***************************************************************************/
+/* NOT binds looser than the comparisons, so NOT A=B is NOT (A=B). Of a
+ * comparison, or of AND, OR or XOR of comparisons, which give 1 or 0, it
+ * is logical and gives 0 or 1 back; of anything else it is a bitwise
+ * complement.
+ */
+short int exprnot()
+{
+	short int a;
+
+	scantable(not_tab);
+	if(table_index == 0) {
+		a = exprnot();
+		if(exp_cmp)
+			return !a;
+		return ~a;
+	}
+	return expr1();
+}
+
+/* AND, OR and XOR are bitwise, of equal precedence and evaluated left to
+ * right.
+ */
+short int expression()
+{
+	short int a,b;
+	uchar op;
+	uchar c;
+
+	a = exprnot();
+	while(1)
+	{
+		/* Check if we have an error */
+		if(exp_error)	return a;
+
+		scantable(logop_tab);
+		if(table_index == LOGOP_UNKNOWN)
+			return a;
+
+		op = table_index;
+		c = exp_cmp;
+		b = exprnot();
+		exp_cmp = c && exp_cmp;
+		switch(op)
+		{
+			case LOGOP_AND:
+				a = a & b;
+				break;
+
+			case LOGOP_OR:
+				a = a | b;
+				break;
+
+			case LOGOP_XOR:
+				a = a ^ b;
+				break;
+		}
+	}
+}
+
+/***************************************************************************/
+/* Parse a variable or array element reference at txtpos and return the
+ * address of its storage, setting *bytes if it is an element of a byte
+ * array. Returns 0 if there is no variable there, or with exp_error set
+ * if the array index is bad.
+ */
+uchar *getvar(bytes)
+uchar *bytes;
+{
+	uchar *var;
+
+	*bytes = 0;
+	if(*txtpos < 'A' || *txtpos > 'Z')
+		return 0;
+
+	if(txtpos[1] == '(') {
+		unsigned int arr_ofs = ((short int *)array_table)[*txtpos - 'A'];
+		uchar arr_esz = ((short int *)array_esz)[*txtpos - 'A'];
+		short int index;
+		index = arr_index(*txtpos - 'A');
+		if (index < 0)
+			return 0;
+		*bytes = (arr_esz == 1);
+		return memory + arr_ofs + index*arr_esz;
+	}
+
+	var = variables_table + (*txtpos - 'A')*VAR_SIZE;
+	txtpos++;
+	return var;
+}
+
+/* store value in a variable or element found by getvar(); byte array
+ * elements keep the low 8 bits
+ */
+voidret storevar(var, bytes, value)
+uchar *var;
+uchar bytes;
+short int value;
+{
+	if(bytes)
+		*var = value;
+	else
+		*(short int *)var = value;
+}
+
+/***************************************************************************/
+/* Parse a signed decimal (or &H hex) number from a typed input line or
+ * a DATA statement. Returns the position after the number and any
+ * trailing blanks, or 0 if there is no number there.
+ */
+uchar *getnum(s, val)
+uchar *s;
+short int *val;
+{
+	uchar isneg = 0;
+	short int num = 0;
+
+	while(*s == SPACE || *s == TAB)
+		s++;
+	if(*s == '-' || *s == '+')
+	{
+		isneg = (*s == '-');
+		s++;
+	}
+	if(s[0] == '&' && (s[1] == 'H' || s[1] == 'h'))
+	{
+		s += 2;
+		if(hexdigit(*s) < 0)
+			return 0;
+		do {
+			num = num*16 + hexdigit(*s);
+			s++;
+		} while(hexdigit(*s) >= 0);
+	}
+	else
+	{
+		if(*s < '0' || *s > '9')
+			return 0;
+		do {
+			num = num*10 + *s - '0';
+			s++;
+		} while(*s >= '0' && *s <= '9');
+	}
+	while(*s == SPACE || *s == TAB)
+		s++;
+
+	if(isneg)
+		num = -num;
+	*val = num;
+	return s;
+}
+
+/***************************************************************************/
+/* Parse a #n file channel reference at txtpos. Returns the channel
+ * number, or 0 if there isn't a valid one.
+ */
+uchar getchan()
+{
+	short int n;
+
+	ignore_blanks();
+	if(*txtpos != '#')
+		return 0;
+	txtpos++;
+	exp_error = 0;
+	n = expr2();
+	if(exp_error || n < 1 || n > NCHAN)
+		return 0;
+	ignore_blanks();
+	return n;
+}
+
+/***************************************************************************/
+/* Parse a bare array name, as used by MAT, at txtpos. Returns the
+ * array number 0-25, or -1 if there isn't a lone letter there.
+ */
+short int getarray()
+{
+	short int name;
+
+	ignore_blanks();
+	if(txtpos[0] < 'A' || txtpos[0] > 'Z')
+		return -1;
+	if((txtpos[1] >= 'A' && txtpos[1] <= 'Z') || txtpos[1] == '(')
+		return -1;
+	name = *txtpos - 'A';
+	txtpos++;
+	ignore_blanks();
+	return name;
+}
+
+/* start of the storage of array name */
+short int *arrptr(name)
+short int name;
+{
+	return (short int *)(memory + ((short int *)array_table)[name]);
+}
+
+/* element i of array name, for the whole-array statements that have
+ * to cope with byte arrays
+ */
+short int elem_get(name, i)
+short int name;
+unsigned int i;
+{
+	if(((short int *)array_esz)[name] == 1)
+		return SIGNCONV(((uchar *)arrptr(name))[i]);
+	return arrptr(name)[i];
+}
+
+voidret elem_put(name, i, value)
+short int name;
+unsigned int i;
+short int value;
+{
+	if(((short int *)array_esz)[name] == 1)
+		((uchar *)arrptr(name))[i] = value;
+	else
+		arrptr(name)[i] = value;
+}
+
+/* 1 if array name holds words, which the host's MAT kernels work on */
+#define WORDARRAY(name) (((short int *)array_esz)[name] == VAR_SIZE)
+
+/* MAT on byte arrays, or a mix of byte and word arrays; op is as for
+ * mat_op() plus 'c' copy, 'f' fill and 's' scale
+ */
+voidret mat_elems(op, dst, src, src2, k, n)
+uchar op;
+short int dst;
+short int src;
+short int src2;
+short int k;
+unsigned int n;
+{
+	unsigned int i;
+	short int a;
+
+	for(i=0; i<n; i++)
+	{
+		switch(op)
+		{
+			case 'f':
+				a = k;
+				break;
+			case 'c':
+				a = elem_get(src, i);
+				break;
+			case 's':
+				a = elem_get(src, i) * k;
+				break;
+			case '+':
+				a = elem_get(src, i) + elem_get(src2, i);
+				break;
+			case '-':
+				a = elem_get(src, i) - elem_get(src2, i);
+				break;
+			default:
+				a = elem_get(src, i) * elem_get(src2, i);
+				break;
+		}
+		elem_put(dst, i, a);
+	}
+}
+
+/* 1 if MAT can write all of array dst from src and src2 */
+uchar mat_fits(dst, src, src2)
+short int dst;
+short int src;
+short int src2;
+{
+	unsigned short n = ((short int *)array_sz)[dst];
+
+	return n != 0 && ((unsigned short *)array_sz)[src] >= n
+		&& ((unsigned short *)array_sz)[src2] >= n;
+}
+
+/* the MAT statement once it has been checked with mat_fits(); op is
+ * as for mat_elems()
+ */
+voidret mat_run(op, dst, src, src2, k)
+uchar op;
+short int dst;
+short int src;
+short int src2;
+short int k;
+{
+	unsigned int n = ((short int *)array_sz)[dst];
+
+	if(!WORDARRAY(dst) || !WORDARRAY(src) || !WORDARRAY(src2))
+		mat_elems(op, dst, src, src2, k, n);
+	else if(op == 'f')
+		mat_fill(arrptr(dst), k, n);
+	else if(op == 'c')
+		mat_copy(arrptr(dst), arrptr(src), n);
+	else if(op == 's')
+		mat_scale(arrptr(dst), arrptr(src), k, n);
+	else
+		mat_op(op, arrptr(dst), arrptr(src), arrptr(src2), n);
+}
+
+/* SORT name, n; returns 0 if n is out of bounds */
+uchar sort_run(name, n, desc)
+short int name;
+unsigned short n;
+uchar desc;
+{
+	if(n > ((unsigned short *)array_sz)[name])
+		return 0;
+	if(WORDARRAY(name))
+		sort_words(arrptr(name), n, desc);
+	else
+		sort_bytes((uchar *)arrptr(name), n, desc);
+	return 1;
+}
+
+/* RANDFILL name, n, range; returns 0 if n is out of bounds */
+uchar randfill_run(name, n, range)
+short int name;
+unsigned short n;
+short int range;
+{
+	unsigned int i;
+
+	if(n > ((unsigned short *)array_sz)[name])
+		return 0;
+	if(WORDARRAY(name))
+		rand_fill(arrptr(name), range, n);
+	else
+		for(i=0; i<n; i++)
+			elem_put(name, i, rand(range));
+	return 1;
+}
+
+/* DIM varnum(arrsize) or, with cols set, DIM varnum(arrsize, cols-1);
+ * returns 0 if there isn't room
+ */
+uchar dim_run(varnum, arrsize, cols, esz)
+uchar varnum;
+unsigned int arrsize;
+unsigned int cols;
+uchar esz;
+{
+	long total;
+
+	total = (long)arrsize+1;
+	if (cols)
+		total = total * cols;
+	if(total > 32767 || !dim(varnum, (unsigned short)total, esz, cols))
+		return 0;
+	return 1;
+}
+
+/***************************************************************************/
+/* forget the run image; called whenever the program text changes */
+voidret pgm_changed()
+{
+	int i;
+
+	for (i=0; i<NATIVE_SITES; i++)
+		native_site[i] = 0;
+	ir_reset();
+	jit_reset();
+	STAT(cmp_stats = 0);
+	image_end = pgm_end;
+	image_ok = 0;
+	data_count = 0;
+	data_lines = 0;
+	data_ptr = 0;
+}
+
+/* Walk the DATA statements of the program. With store set, copy their
+ * values into the pool and fill in the line index, otherwise just count
+ * them. Returns 0 with current_line and txtpos at the problem if a DATA
+ * statement is malformed.
+ */
+uchar scan_data(store)
+uchar store;
+{
+	uchar *line;
+	uchar *s;
+	uchar quote;
+	short int value;
+
+	data_count = 0;
+	data_lines = 0;
+	for(line = pgm_start; line != pgm_end; line += line[sizeof(LINENUM)])
+	{
+		txtpos = line+sizeof(LINENUM)+sizeof(char);
+		while(1)
+		{
+			scantable(keywords);
+			if(table_index == KW_REM)
+				break;
+			if(table_index == KW_DATA)
+			{
+				/* DATA runs to the end of the line */
+				if(store) {
+					data_index[2*data_lines] = decode_linenum(line);
+					data_index[2*data_lines+1] = data_count;
+				}
+				data_lines++;
+				while(1)
+				{
+					s = getnum(txtpos, &value);
+					if(s == 0) {
+						current_line = line;
+						return 0;
+					}
+					if(store)
+						data_pool[data_count] = value;
+					data_count++;
+					txtpos = s;
+					if(*txtpos == NL)
+						break;
+					if(*txtpos != ',') {
+						current_line = line;
+						return 0;
+					}
+					txtpos++;
+				}
+				break;
+			}
+
+			/* skip to the next statement on the line */
+			quote = 0;
+			while(*txtpos != NL && (quote || *txtpos != ':'))
+			{
+				if(*txtpos == quote)
+					quote = 0;
+				else if(quote == 0 && (*txtpos == '"' || *txtpos == '\''))
+					quote = *txtpos;
+				txtpos++;
+			}
+			if(*txtpos == NL)
+				break;
+			txtpos++;
+		}
+	}
+	return 1;
+}
+
+/* return values for build_image() */
+#define IMAGE_OK 0
+#define IMAGE_SYNTAX 1
+#define IMAGE_NOMEM 2
+
+/* Build the run image above the program. At RUN it goes straight after
+ * the program text. When a READ finds no image (the program was started
+ * with GOTO) the typed line at LINEBUF may still be running, so the image
+ * goes after it instead. On IMAGE_SYNTAX current_line and txtpos point
+ * at the bad DATA statement.
+ */
+uchar build_image(lazy)
+uchar lazy;
+{
+	uchar *save_txtpos = txtpos;
+	uchar *save_line = current_line;
+	uchar *base;
+
+	pgm_changed();
+	if(!scan_data(0))
+		return IMAGE_SYNTAX;
+
+	base = pgm_end;
+	if(lazy) {
+		base = LINEBUF;
+		while(base < sp && *base != NL)
+			base++;
+		base++;
+	}
+	if((base - memory) & 1)
+		base++;  /* zcc does not like words at odd offsets */
+	if((long)(data_count + 2*data_lines)*VAR_SIZE > (sp - base) - MINFREE)
+		return IMAGE_NOMEM;
+
+	data_pool = (short int *)base;
+	data_index = (unsigned short *)(data_pool + data_count);
+	scan_data(1);
+	image_end = (uchar *)(data_index + 2*data_lines);
+	image_ok = 1;
+	data_ptr = 0;
+
+	txtpos = save_txtpos;
+	current_line = save_line;
+	return IMAGE_OK;
+}
+
+/* pool offset of the first DATA line numbered ln or later */
+unsigned short data_find(ln)
+LINENUM ln;
+{
+	unsigned short lo = 0;
+	unsigned short hi = data_lines;
+	unsigned short mid;
+
+	while(lo < hi)
+	{
+		mid = (lo+hi)/2;
+		if(data_index[2*mid] < ln)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	if(lo == data_lines)
+		return data_count;
+	return data_index[2*lo+1];
+}
+
+/***************************************************************************/
+uchar procline()
+{
+	uchar *start;
+	uchar *newEnd;
+	uchar linelen;
+
+	if (!getln('\0')) {
+		return PROCLINE_EOF;
+	}
+	toUppercaseBuffer();
+
+	txtpos = LINEBUF;
+
+	/* Find the end of the freshly entered line */
+	linelen=0;
+	while(*txtpos != NL) {
+		linelen++;
+		txtpos++;
+	}
+
+	/* Move it to the end of program_memory */
+	{
+		uchar *dest;
+		dest = sp-1;
+
+    /* zcc does not like words written to odd offsets */
+    if ((linelen%2)==0) {
+			dest--;
+		}
+
+		while(1)
+		{
+			*dest = *txtpos;
+			if(txtpos == LINEBUF)
+				break;
+			dest--;
+			txtpos--;
+		}
+		txtpos = dest;
+	}
+
+	/* Now see if we have a line number */
+	linenum = testnum();
+	ignore_blanks();
+	if(linenum == 0) {
+		if ((*txtpos==NL) || (*txtpos==CR)) {
+			return PROCLINE_EMPTY;
+		}
+	  return PROCLINE_DIRECT;
+	}
+
+	if(linenum == 0xFFFF)
+	  return PROCLINE_BADLINE;
+
+	/* Find the length of what is left, including the (yet-to-be-populated) line header */
+	linelen = 0;
+	while(txtpos[linelen] != NL)
+		linelen++;
+	linelen++; /* Include the NL in the line length */
+	linelen += sizeof(unsigned short)+sizeof(char); /* Add space for the line number and line length */
+
+	/* Now we have the number, add the line header. */
+	txtpos -= 3;
+	encode_linenum(txtpos, linenum);
+	txtpos[sizeof(LINENUM)] = linelen;
+
+	/* Merge it into the rest of the program */
+	start = findline();
+
+	/* If a line with that number exists, then remove it */
+	/*if(start != pgm_end && *((LINENUM *)start) == linenum) {*/
+	if (start != pgm_end && decode_linenum(start)==linenum) {
+		uchar *dest, *from;
+		unsigned tomove;
+
+		from = start + start[sizeof(LINENUM)];
+		dest = start;
+
+		tomove = pgm_end - from;
+		while( tomove > 0)
+		{
+			*dest = *from;
+			from++;
+			dest++;
+			tomove--;
+		}	
+		pgm_end = dest;
+	}
+
+	if(txtpos[sizeof(LINENUM)+sizeof(char)] == NL) {
+		/* If the line has no txt, it was just a delete */
+		pgm_changed();
+		return PROCLINE_DELETE;
+	}
+
+	/* Make room for the new line, either all in one hit or lots of little shuffles */
+	while(linelen > 0)
+	{	
+		unsigned int tomove;
+		uchar *from,*dest;
+		unsigned int space_to_make;
+
+		space_to_make = txtpos - pgm_end;
+
+		if(space_to_make > linelen)
+			space_to_make = linelen;
+		newEnd = pgm_end+space_to_make;
+		tomove = pgm_end - start;
+
+		/* Source and destination - as these areas may overlap we need to move bottom up */
+		from = pgm_end;
+		dest = newEnd;
+		while(tomove > 0)
+		{
+			from--;
+			dest--;
+			*dest = *from;
+			tomove--;
+		}
+
+		/* Copy over the bytes into the new space */
+		for(tomove = 0; tomove < space_to_make; tomove++)
+		{
+			*start = *txtpos;
+			txtpos++;
+			start++;
+			linelen--;
+		}
+		pgm_end = newEnd;
+	}
+	pgm_changed();
+	return PROCLINE_OKAY;
+}
+
+voidret loadpgm()
+{
+  uchar res;
+	uchar lecho_save;
+
+  lecho_save = lecho;
+	lecho = 0;
+	pgm_end = pgm_start;
+	pgm_changed();
+	while (1) {
+		res = procline();
+		if ((res != PROCLINE_OKAY) && (res != PROCLINE_EMPTY)) {
+			lecho = lecho_save;
+			return 0;
+		}
+	}
+}
+
+/* erase all variables and un-declare all arrays */
+voidret clear()
+{
+	int i;
+	for (i=0; i<26; i++) {
+		((short int *)variables_table)[i] = 0;
+		((short int *)array_table)[i] = 0;
+		((short int *)array_sz)[i] = 0;
+		((short int *)array_esz)[i] = 0;
+		((short int *)array_cols)[i] = 0;
+	}
+	top_sp = memory+sizeof(memory);
+	sp = top_sp;  /* Needed for printnum */
+	jit_reset();
+}
+
+voidret initialize()
+{
+	variables_table = memory;
+	array_table = memory + NUM_VAR*VAR_SIZE;
+	array_sz = array_table + NUM_VAR*VAR_SIZE;
+	array_esz = array_sz + NUM_VAR*VAR_SIZE;
+	array_cols = array_esz + NUM_VAR*VAR_SIZE;
+	pgm_start = array_cols + NUM_VAR*VAR_SIZE;
+	pgm_end = pgm_start;
+	pgm_changed();
+	clear();
+}
+
+voidret banner()
+{
+	printmsg(initmsg);
+	printnum(sp-image_end);
+	printmsg(memorymsg);
+}
+
+/***************************************************************************/
+/* start the statement and time quotas for a new run */
+voidret quota_reset()
+{
+	stmt_left = stmt_budget;
+	quota_tick = 0;
+	if (time_limit)
+		run_start = host_millis();
+}
+
+/* called when quota_tick runs out. Returns 1 if the run is over its
+ * statement budget or its time limit, otherwise hands out the next
+ * span of statements and returns 0.
+ */
+uchar quota_check()
+{
+	if (stmt_budget && stmt_left <= 0) {
+		quota_msg = stmtlimitmsg;
+		exit_code = EXIT_STMTLIMIT;
+		return 1;
+	}
+	if (time_limit && host_millis() - run_start >= time_limit) {
+		quota_msg = timelimitmsg;
+		exit_code = EXIT_TIMELIMIT;
+		return 1;
+	}
+
+	quota_tick = QUOTA_SPAN;
+	if (stmt_budget) {
+		if (stmt_left < QUOTA_SPAN)
+			quota_tick = stmt_left;
+		stmt_left -= quota_tick;
+	}
+	quota_tick--; /* the statement about to run */
+	return 0;
+}
+
+/***************************************************************************/
+/* The Z8000 estimate, -z. The run is charged a number of cycles for each
+ * statement by keyword, each character scantable() compares, each line
+ * findline() steps past and each port access, counted by the STATS
+ * counters, and turned into a time at the target's clock rate. Only the
+ * text interpreter is counted, so -z implies -I and -J. The costs can
+ * be set from a file, with lines such as "PRINT 1500" or "SCAN 30":
+ * a keyword, ASSIGN for an assignment without LET, SCAN, LINE, PORT,
+ * or CLOCK for the clock rate in kHz.
+ */
+#ifndef NOSTATS
+uchar est_on;
+long est_cost[KW_DEFAULT+1];  /* cycles for a statement, by keyword */
+long est_scan;                /* for a character scantable() compares */
+long est_line;                /* for a line findline() steps past */
+long est_port;                /* for an INP() or OUT */
+long est_khz;                 /* the clock */
+
+uchar est_tab[] = {
+	'A','S','S','I','G','N'+0x80,
+	'S','C','A','N'+0x80,
+	'L','I','N','E'+0x80,
+	'P','O','R','T'+0x80,
+	'C','L','O','C','K'+0x80,
+	0
+};
+#define EST_ASSIGN 0
+#define EST_SCAN   1
+#define EST_LINE   2
+#define EST_PORT   3
+#define EST_CLOCK  4
+
+/* rough figures for the zcc build on a 4 MHz board; a cost file can
+ * replace them with ones measured there
+ */
+voidret est_defaults()
+{
+	int i;
+
+	for (i = 0; i <= KW_DEFAULT; i++)
+		est_cost[i] = 400;
+	est_cost[KW_DEFAULT] = est_cost[KW_LET] = 600;
+	est_cost[KW_PRINT] = 1500;
+	est_cost[KW_INPUT] = 2000;
+	est_cost[KW_IF] = 300;
+	est_cost[KW_GOTO] = 300;
+	est_cost[KW_GOSUB] = 500;
+	est_cost[KW_FOR] = est_cost[KW_PARFOR] = 900;
+	est_cost[KW_NEXT] = 700;
+	est_cost[KW_DIM] = 2000;
+	est_scan = 30;
+	est_line = 40;
+	est_port = 20;
+	est_khz = 4000;
+}
+
+/* read the costs in file fn; returns 0 if it can't */
+uchar est_load(fn)
+char *fn;
+{
+	uchar buf[40];
+	int n;
+	uchar c;
+	uchar name;
+	long *cost;
+	uchar ok = 1;
+
+	if (!open_read(fn))
+		return 0;
+	do {
+		n = 0;
+		while ((c = getch()) != EOFC && c != NL) {
+			if (c >= 'a' && c <= 'z')
+				c = c + 'A' - 'a';
+			if (n < sizeof(buf)-1 && c != CR)
+				buf[n++] = c;
+		}
+		buf[n] = NL;
+		txtpos = buf;
+		ignore_blanks();
+		if (*txtpos == NL)
+			continue;
+
+		scantable(est_tab);
+		name = table_index;
+		switch (name) {
+			case EST_ASSIGN: cost = est_cost + KW_DEFAULT; break;
+			case EST_SCAN:   cost = &est_scan; break;
+			case EST_LINE:   cost = &est_line; break;
+			case EST_PORT:   cost = &est_port; break;
+			case EST_CLOCK:  cost = &est_khz; break;
+			default:
+				txtpos = buf;
+				scantable(keywords);
+				cost = est_cost + table_index;
+				break;
+		}
+		if (cost == est_cost + KW_DEFAULT && name != EST_ASSIGN)
+			ok = 0;  /* not a name we know */
+		else if (*txtpos < '0' || *txtpos > '9')
+			ok = 0;
+		else {
+			*cost = testnum();
+			ignore_blanks();
+			if (*txtpos != NL)
+				ok = 0;
+		}
+	} while (ok && c != EOFC);
+	close_file();
+	return ok && est_khz > 0;
+}
+
+long est_cycles()
+{
+	long c;
+	int i;
+
+	c = stat_scans*est_scan + stat_lines*est_line + stat_ports*est_port;
+	for (i = 0; i <= KW_DEFAULT; i++)
+		c += stat_kw[i]*est_cost[i];
+	return c;
+}
+#endif
+
+/***************************************************************************/
+/* STATS, and -S at exit */
+voidret stats_reset()
+{
+#ifndef NOSTATS
+	int i;
+
+	stat_stmts = stat_finds = stat_lines = stat_scans = stat_frames = 0;
+	stat_ports = stat_putch = 0;
+	for (i = 0; i <= KW_DEFAULT; i++)
+		stat_kw[i] = 0;
+	stat_peak = 0;
+#endif
+}
+
+voidret stats_line(msg, n)
+const uchar *msg;
+long n;
+{
+	printnnl(msg);
+	ir_putlong(n);
+	put_nl();
+}
+
+voidret stats_show()
+{
+#ifndef NOSTATS
+	if (stats_part)
+		printmsg("Compiled code ran uncounted; RUN again for exact counts");
+	stats_line("statements run      ", stat_stmts);
+	stats_line("line searches       ", stat_finds);
+	stats_line("lines searched      ", stat_lines);
+	stats_line("keyword compares    ", stat_scans);
+	stats_line("stack frames walked ", stat_frames);
+	stats_line("characters output   ", stat_putch);
+#endif
+	stats_line("program bytes       ", (long)(pgm_end - pgm_start));
+	stats_line("array bytes         ", (long)(memory + sizeof(memory) - top_sp));
+	stats_line("stack bytes         ", (long)(top_sp - sp));
+#ifndef NOSTATS
+	stats_line("most stack bytes    ", (long)stat_peak);
+	if (est_on) {
+		stats_line("Z8000 cycles        ", est_cycles());
+		stats_line("Z8000 milliseconds  ", est_cycles() / est_khz);
+	}
+#endif
+}
+
+/***************************************************************************/
+/* The sampling profiler, -p. PROF_HZ times a second of processor time
+ * the host interrupts the run and prof_tick() notes the line it's at
+ * together with the lines of the GOSUBs still waiting to RETURN, taken
+ * from the stack. Each different stack of lines gets one slot and a
+ * count, and at exit they are written one to a line, outermost caller
+ * first, as "20;150;300 42": the folded form flame graph tools read.
+ * Nothing is done for the statements themselves, so the run only pays
+ * for the interrupts.
+ */
+#define PROF_HZ 1000
+#define PROF_DEPTH 16    /* lines kept per sample, the innermost ones */
+#define PROF_SLOTS 1024  /* different stacks kept; more are counted as lost */
+
+struct prof_slot {
+	long count;
+	uchar depth;
+	unsigned short lines[PROF_DEPTH];  /* innermost first */
+};
+struct prof_slot prof_tab[PROF_SLOTS];
+long prof_lost;
+uchar prof_on;
+
+/* the line number of a line pointer, or 0 if it isn't into the program */
+unsigned short prof_linenum(line)
+uchar *line;
+{
+	if (line < pgm_start || line >= pgm_end)
+		return 0;
+	return decode_linenum(line);
+}
+
+/* the signal handler: count the line being run and its callers */
+voidret prof_tick()
+{
+	unsigned short lines[PROF_DEPTH];
+	uchar depth = 0;
+	uchar *f;
+	uchar *line;
+	unsigned short h;
+	int i;
+	int n;
+
+	/* compiled code doesn't move current_line until it's done */
+	if (jit_line)
+		line = jit_line;
+	else if (ir_at > 0 && ir_at <= cmp_stmts)
+		line = pgm_start + cmp_stmt[ir_at-1].line;
+	else
+		line = current_line;
+	if ((lines[depth] = prof_linenum(line)) != 0)
+		depth++;
+
+	/* the sample may land while a frame is half pushed, so stop at
+	 * anything that doesn't look like one
+	 */
+	f = sp;
+	n = depth;
+	while (f >= sp && f < top_sp && depth < PROF_DEPTH) {
+		if (f[0] == STACK_FOR_FLAG)
+			f += sizeof(struct stack_for_frame);
+		else if (f[0] == STACK_GOSUB_FLAG) {
+			lines[depth] = prof_linenum(((struct stack_gosub_frame *)f)->sgf_current_line);
+			if (lines[depth] == 0)
+				break;
+			/* a GOSUB that hasn't jumped yet, or a RETURN that has
+			 * popped back to its line, would count the line twice
+			 */
+			if (depth != n || depth == 0 || lines[depth] != lines[0])
+				depth++;
+			f += sizeof(struct stack_gosub_frame);
+		} else
+			break;
+	}
+	if (depth == 0)
+		return 0;
+
+	h = depth;
+	for (i = 0; i < depth; i++)
+		h = h * 31 + lines[i];
+	for (n = 0; n < PROF_SLOTS; n++) {
+		struct prof_slot *ps = prof_tab + (h + n) % PROF_SLOTS;
+
+		if (ps->count == 0) {
+			ps->depth = depth;
+			for (i = 0; i < depth; i++)
+				ps->lines[i] = lines[i];
+		} else if (ps->depth != depth)
+			continue;
+		else {
+			for (i = 0; i < depth && ps->lines[i] == lines[i]; i++)
+				;
+			if (i < depth)
+				continue;
+		}
+		ps->count++;
+		return 0;
+	}
+	prof_lost++;
+}
+
+/* sample the run about to start, if there's a profile to write */
+voidret prof_start()
+{
+	if (prof_file && !prof_on)
+		prof_on = host_profile(PROF_HZ, prof_tick);
+}
+
+voidret prof_stop()
+{
+	if (prof_on)
+		host_profile(0, prof_tick);
+	prof_on = 0;
+}
+
+/* write the samples of every run to prof_file; returns 0 if it can't */
+uchar prof_write()
+{
+	struct prof_slot *ps;
+	int i;
+
+	prof_stop();
+	if (!open_write(prof_file))
+		return 0;
+	for (ps = prof_tab; ps < prof_tab + PROF_SLOTS; ps++) {
+		if (ps->count == 0)
+			continue;
+		for (i = ps->depth-1; i >= 0; i--) {
+			ir_putlong((long)ps->lines[i]);
+			putch(i ? ';' : ' ');
+		}
+		ir_putlong(ps->count);
+		putch(NL);
+	}
+	if (prof_lost) {
+		printnnl("(lost) ");
+		ir_putlong(prof_lost);
+		putch(NL);
+	}
+	close_file();
+	return 1;
+}
+
+/***************************************************************************/
+/* The compiled form of the program, see tbasic.h. The parsers below
+ * follow expression() and the statement handlers in loop() step by step
+ * and use the same scanning routines, so they take exactly the text the
+ * interpreter takes. Errors that depend on values, such as division by
+ * zero or an index out of bounds, are left to whoever runs the result.
+ */
+struct cnode cmp_node[CMP_NODES];
+struct cstmt cmp_stmt[CMP_STMTS];
+short int cmp_nodes;
+short int cmp_stmts;
+uchar cmp_full;  /* ran out of room for nodes or statements */
+uchar cmp_fail;  /* how the statement being compiled fails, CE_* */
+
+/* a new node, or -1 if there's no room */
+short int cnode(op, n, val, a, b)
+uchar op;
+uchar n;
+short int val;
+short int a;
+short int b;
+{
+	struct cnode *x;
+
+	if(cmp_nodes >= CMP_NODES) {
+		cmp_full = 1;
+		return -1;
+	}
+	x = cmp_node + cmp_nodes;
+	x->op = op;
+	x->n = n;
+	x->val = val;
+	x->a = a;
+	x->b = b;
+	return cmp_nodes++;
+}
+
+/* append item to the list whose head and last cell are *head and *tail,
+ * recording where the text after the item starts
+ */
+uchar c_append(head, tail, item)
+short int *head;
+short int *tail;
+short int item;
+{
+	short int cell;
+
+	cell = cnode(X_ARG, 0, txtpos - pgm_start, item, -1);
+	if(cell < 0)
+		return 0;
+	if(*head < 0)
+		*head = cell;
+	else
+		cmp_node[*tail].b = cell;
+	*tail = cell;
+	return 1;
+}
+
+short int c_expression();
+short int c_expr2();
+
+/* A(i) or A(i,j) with txtpos on the letter, as arr_index() */
+short int c_elem()
+{
+	uchar name = *txtpos - 'A';
+	short int i, j = -1;
+
+	txtpos += 2;
+	i = c_expression();
+	if(i < 0)
+		return -1;
+	if(*txtpos == ',') {
+		txtpos++;
+		j = c_expression();
+		if(j < 0)
+			return -1;
+	}
+	if(*txtpos != ')')
+		return -1;
+	txtpos++;
+	ignore_blanks();
+	return cnode(X_ELEM, name, 0, i, j);
+}
+
+/* n comma separated arguments and the closing paren, as getargs() */
+uchar c_args(list, n)
+short int *list;
+int n;
+{
+	short int tail;
+	short int e;
+	int i;
+
+	*list = -1;
+	for(i=0; i<n; i++)
+	{
+		if(i > 0)
+		{
+			if(*txtpos != ',')
+				return 0;
+			txtpos++;
+		}
+		e = c_expression();
+		if(e < 0 || !c_append(list, &tail, e))
+			return 0;
+	}
+	if(*txtpos != ')')
+		return 0;
+	txtpos++;
+	return 1;
+}
+
+short int c_expr4()
+{
+	uchar f;
+	short int a = 0;
+	short int list, tail;
+	short int e;
+
+	ignore_blanks();
+
+	if(number_at(&a))
+	{
+		e = cnode(X_NUM, 0, a, -1, -1);
+		goto success;
+	}
+
+	if(txtpos[0] >= 'A' && txtpos[0] <= 'Z')
+	{
+		if (txtpos[1]=='(') {
+			e = c_elem();
+			goto success;
+		}
+
+		if(txtpos[1] < 'A' || txtpos[1] > 'Z')
+		{
+			e = cnode(X_VAR, *txtpos - 'A', 0, -1, -1);
+			txtpos++;
+			goto success;
+		}
+
+		scantable(func_tab);
+		if(table_index == FUNC_UNKNOWN) {
+			int n;
+
+			n = native_match(&txtpos);
+			if(n < 0)
+				return -1;
+			ignore_blanks();
+			if(*txtpos != '(')
+				return -1;
+			txtpos++;
+			if(!c_args(&list, native_arity[n]))
+				return -1;
+			e = cnode(X_NATIVE, n, 0, list, -1);
+			goto success;
+		}
+
+		f = table_index;
+		if (f == FUNC_HIGH || f == FUNC_LOW) {
+			e = cnode(X_NUM, 0, f == FUNC_HIGH, -1, -1);
+			goto success;
+		}
+
+		if(*txtpos != '(')
+			return -1;
+		txtpos++;
+		list = -1;
+		if (f == FUNC_SEARCH) {
+			short int name = getarray();
+			if(name < 0 || *txtpos != ',')
+				return -1;
+			txtpos++;
+			e = cnode(X_NUM, 0, name, -1, -1);
+			if(e < 0 || !c_append(&list, &tail, e))
+				return -1;
+			e = c_expression();
+			if(e < 0 || *txtpos != ',' || !c_append(&list, &tail, e))
+				return -1;
+			txtpos++;
+			e = c_expression();
+			if(e < 0 || *txtpos != ')' || !c_append(&list, &tail, e))
+				return -1;
+			txtpos++;
+		}
+		else if (f == FUNC_MEMSUM || f == FUNC_CRC) {
+			if (!c_args(&list, 2))
+				return -1;
+		}
+		else {
+			/* ATN(t) or ATN(y,x), or any other function of one argument */
+			e = c_expression();
+			if(e < 0 || !c_append(&list, &tail, e))
+				return -1;
+			if (f == FUNC_ATN && *txtpos == ',') {
+				txtpos++;
+				e = c_expression();
+				if(e < 0 || !c_append(&list, &tail, e))
+					return -1;
+			}
+			if(*txtpos != ')')
+				return -1;
+			txtpos++;
+		}
+		e = cnode(X_FUNC, f, 0, list, -1);
+		goto success;
+	}
+
+	if(*txtpos == '(')
+	{
+		txtpos++;
+		e = c_expression();
+		if(e < 0 || *txtpos != ')')
+			return -1;
+		txtpos++;
+		goto success;
+	}
+	return -1;
+
+success:
+	ignore_blanks();
+	return e;
+}
+
+short int c_expr3()
+{
+	short int a, b;
+	uchar op;
+
+	a = c_expr4();
+	while(a >= 0)
+	{
+		if(*txtpos == '*' || *txtpos == '/') {
+			op = *txtpos == '*' ? X_MUL : X_DIV;
+			txtpos++;
+		} else if (*txtpos == 'M' && *(txtpos+1)=='O' && *(txtpos+2)=='D') {
+			op = X_MOD;
+			txtpos += 3;
+		}
+		else
+			break;
+		b = c_expr4();
+		a = b < 0 ? -1 : cnode(op, 0, 0, a, b);
+	}
+	return a;
+}
+
+short int c_expr2()
+{
+	short int a, b;
+	uchar op;
+
+	if(*txtpos == '-' || *txtpos == '+')
+		a = cnode(X_NUM, 0, 0, -1, -1);
+	else
+		a = c_expr3();
+
+	while(a >= 0)
+	{
+		if(*txtpos == '-')
+			op = X_SUB;
+		else if(*txtpos == '+')
+			op = X_ADD;
+		else
+			break;
+		txtpos++;
+		b = c_expr3();
+		a = b < 0 ? -1 : cnode(op, 0, 0, a, b);
+	}
+	return a;
+}
+
+short int c_exprshift()
+{
+	short int a, b;
+	uchar op;
+
+	a = c_expr2();
+	while(a >= 0)
+	{
+		scantable(shift_tab);
+		if(table_index == SHIFT_UNKNOWN)
+			break;
+		op = table_index == SHIFT_LEFT ? X_SHL : X_SHR;
+		b = c_expr2();
+		a = b < 0 ? -1 : cnode(op, 0, 0, a, b);
+	}
+	return a;
+}
+
+short int c_expr1()
+{
+	short int a, b;
+	uchar op;
+
+	a = c_exprshift();
+	if(a < 0)
+		return -1;
+	scantable(relop_tab);
+	if(table_index == RELOP_UNKNOWN)
+		return a;
+	op = X_GE + table_index;
+	b = c_exprshift();
+	return b < 0 ? -1 : cnode(op, 0, 0, a, b);
+}
+
+/* 1 if node x gives 1 or 0, as exprnot() tracks with exp_cmp */
+uchar c_truth(x)
+short int x;
+{
+	struct cnode *n = cmp_node + x;
+
+	if(n->op >= X_GE && n->op <= X_LT)
+		return 1;
+	if(n->op >= X_AND && n->op <= X_XOR)
+		return c_truth(n->a) && c_truth(n->b);
+	return 0;
+}
+
+short int c_exprnot()
+{
+	short int a;
+	short int z;
+
+	scantable(not_tab);
+	if(table_index == 0) {
+		a = c_exprnot();
+		if(a < 0)
+			return -1;
+		if(!c_truth(a))
+			return cnode(X_NOT, 0, 0, a, -1);
+		/* a logical NOT: a=0 */
+		z = cnode(X_NUM, 0, 0, -1, -1);
+		return z < 0 ? -1 : cnode(X_EQ, 0, 0, a, z);
+	}
+	return c_expr1();
+}
+
+short int c_expression()
+{
+	short int a, b;
+	uchar op;
+
+	a = c_exprnot();
+	while(a >= 0)
+	{
+		scantable(logop_tab);
+		if(table_index == LOGOP_UNKNOWN)
+			break;
+		op = X_AND + table_index;
+		b = c_exprnot();
+		a = b < 0 ? -1 : cnode(op, 0, 0, a, b);
+	}
+	return a;
+}
+
+/* an expression in a statement; a bad one is an Invalid expression */
+short int c_value()
+{
+	short int e = c_expression();
+
+	if(e < 0)
+		cmp_fail = CE_INVALID;
+	return e;
+}
+
+/* a variable or element to store to, as getvar() */
+short int c_var()
+{
+	short int e;
+
+	if(*txtpos < 'A' || *txtpos > 'Z') {
+		cmp_fail = CE_SYNTAX;
+		return -1;
+	}
+	if(txtpos[1] == '(') {
+		e = c_elem();
+		if(e < 0)
+			cmp_fail = CE_INVALID;
+		return e;
+	}
+	e = cnode(X_VAR, *txtpos - 'A', 0, -1, -1);
+	txtpos++;
+	return e;
+}
+
+/* the variable list of INPUT or READ */
+short int c_varlist()
+{
+	short int list = -1;
+	short int tail;
+	short int e;
+
+	while(1)
+	{
+		e = c_var();
+		if(e < 0 || !c_append(&list, &tail, e))
+			return -1;
+		ignore_blanks();
+		if(*txtpos != ',')
+			break;
+		txtpos++;
+		ignore_blanks();
+	}
+	if(!check_statement_end()) {
+		cmp_fail = CE_SYNTAX;
+		return -1;
+	}
+	return list;
+}
+
+/* #n as getchan(): a list cell holding the channel expression, whose
+ * val is where a bad channel number is reported
+ */
+short int c_chan()
+{
+	short int list = -1;
+	short int tail;
+	short int e;
+
+	ignore_blanks();
+	if(*txtpos != '#')
+		return -1;
+	txtpos++;
+	e = c_expr2();
+	if(e < 0 || !c_append(&list, &tail, e))
+		return -1;
+	ignore_blanks();
+	return list;
+}
+
+/* Compile the statement at txtpos into st. Returns 0 with cmp_fail set
+ * and txtpos where the interpreter gives up if it can't be compiled.
+ */
+uchar c_statement(st)
+struct cstmt *st;
+{
+	short int tail;
+	short int e;
+	int i;
+
+	cmp_fail = CE_SYNTAX;
+	scantable(keywords);
+	ignore_blanks();
+
+	switch(table_index)
+	{
+		case KW_LIST:
+		case KW_LOAD:
+		case KW_NEW:
+		case KW_RUN:
+		case KW_SAVE:
+			cmp_fail = CE_DIRECT;
+			return 0;
+		case KW_STATS:
+			STAT(cmp_stats = 1);
+			cmp_fail = CE_DIRECT;
+			return 0;
+		case KW_NEXT:
+			ignore_blanks();
+			if(*txtpos < 'A' || *txtpos > 'Z')
+				return 0;
+			txtpos++;
+			if(!check_statement_end())
+				return 0;
+			st->op = S_NEXT;
+			st->n = txtpos[-1];
+			return 1;
+		case KW_LET:
+		case KW_DEFAULT:
+			st->op = S_LET;
+			st->a = c_var();
+			if(st->a < 0)
+				return 0;
+			ignore_blanks();
+			if (*txtpos != '=')
+				return 0;
+			txtpos++;
+			ignore_blanks();
+			st->b = c_value();
+			if(st->b < 0)
+				return 0;
+			return check_statement_end();
+		case KW_IF:
+			st->op = S_IF;
+			st->a = c_value();
+			cmp_fail = CE_INVALID;
+			return st->a >= 0 && *txtpos != NL;
+		case KW_GOTO:
+		case KW_GOSUB:
+			st->op = table_index == KW_GOTO ? S_GOTO : S_GOSUB;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			if(st->op == S_GOTO)
+				cmp_fail = CE_INVALID;
+			return *txtpos == NL;
+		case KW_RETURN:
+			st->op = S_RETURN;
+			return 1;
+		case KW_REM:
+		case KW_DATA:
+			st->op = S_REM;
+			return 1;
+		case KW_FOR:
+		case KW_PARFOR:
+			st->op = table_index == KW_FOR ? S_FOR : S_PARFOR;
+			if(*txtpos < 'A' || *txtpos > 'Z')
+				return 0;
+			st->n = *txtpos - 'A';
+			txtpos++;
+			scantable(relop_tab);
+			if(table_index != RELOP_EQ)
+				return 0;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			scantable(to_tab);
+			if(table_index != 0)
+				return 0;
+			st->b = c_value();
+			if(st->b < 0)
+				return 0;
+			scantable(step_tab);
+			if(table_index == 0) {
+				st->c = c_value();
+				if(st->c < 0)
+					return 0;
+			}
+			return check_statement_end() && *txtpos == NL;
+		case KW_INPUT:
+			st->op = S_INPUT;
+			ignore_blanks();
+			if(*txtpos == '#')
+			{
+				st->a = c_chan();
+				if(st->a < 0 || *txtpos != ',')
+					return 0;
+				txtpos++;
+				ignore_blanks();
+			}
+			st->b = c_varlist();
+			return st->b >= 0;
+		case KW_PRINT:
+			st->op = S_PRINT;
+			if(*txtpos == '#')
+			{
+				st->a = c_chan();
+				if(st->a < 0) {
+					cmp_fail = CE_IO;
+					return 0;
+				}
+				if(*txtpos == ',')
+				{
+					txtpos++;
+					ignore_blanks();
+				}
+				else if(!check_statement_end())
+					return 0;
+			}
+			if(*txtpos == ':')
+			{
+				txtpos++;
+				return 1;
+			}
+			if(*txtpos == NL)
+				return 1;
+			while(1)
+			{
+				ignore_blanks();
+				if(*txtpos == '"' || *txtpos == '\'')
+				{
+					/* as print_quoted_string() */
+					i = 1;
+					while(txtpos[i] != *txtpos)
+					{
+						if(txtpos[i] == NL)
+							return 0;
+						i++;
+					}
+					e = cnode(X_STR, 0, txtpos+1 - pgm_start, i-1, -1);
+					txtpos += i+1;
+					ignore_blanks();
+				}
+				else
+				{
+					e = c_value();
+					if(e < 0)
+						return 0;
+				}
+				if(e < 0 || !c_append(&st->b, &tail, e))
+					return 0;
+
+				if(*txtpos == ',')
+					txtpos++;
+				else if(txtpos[0] == ';' && (txtpos[1] == NL || txtpos[1] == ':'))
+				{
+					txtpos++;
+					st->n = 1;
+					return 1;
+				}
+				else
+					return check_statement_end();
+			}
+		case KW_POKE:
+		case KW_OUT:
+			st->op = table_index == KW_POKE ? S_POKE : S_OUT;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			ignore_blanks();
+			if (*txtpos != ',')
+				return 0;
+			txtpos++;
+			ignore_blanks();
+			st->b = c_value();
+			if(st->b < 0)
+				return 0;
+			return check_statement_end();
+		case KW_STOP:
+		case KW_END:
+			st->op = table_index == KW_STOP ? S_STOP : S_END;
+			return txtpos[0] == NL;
+		case KW_BYE:
+		case KW_SYSTEM:
+			st->op = S_BYE;
+			return 1;
+		case KW_SLEEP:
+			st->op = S_SLEEP;
+			st->a = c_value();
+			return st->a >= 0;
+		case KW_CLEAR:
+			st->op = S_CLEAR;
+			return 1;
+		case KW_DIM:
+			st->op = S_DIM;
+			if(*txtpos < 'A' || *txtpos > 'Z')
+				return 0;
+			st->n = *txtpos - 'A';
+			txtpos++;
+			st->c = VAR_SIZE;
+			if (*txtpos == '%') {
+				st->c = 1;
+				txtpos++;
+			}
+			ignore_blanks();
+			if (*txtpos != '(')
+				return 0;
+			txtpos++;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			if (*txtpos == ',') {
+				txtpos++;
+				st->b = c_value();
+				if(st->b < 0)
+					return 0;
+			}
+			if (*txtpos != ')')
+				return 0;
+			txtpos++;
+			return check_statement_end();
+		case KW_READ:
+			st->op = S_READ;
+			st->b = c_varlist();
+			return st->b >= 0;
+		case KW_RESTORE:
+			st->op = S_RESTORE;
+			if(check_statement_end())
+				return 1;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			return check_statement_end();
+		case KW_OPEN:
+			st->op = S_OPEN;
+			e = txtpos+1 - pgm_start;
+			if(!get_quoted_string(fn))
+				return 0;
+			for(i=0; fn[i]; i++)
+				;
+			st->b = cnode(X_STR, 0, e, i, -1);
+			scantable(for_tab);
+			if(table_index != 0)
+				return 0;
+			scantable(mode_tab);
+			if(table_index == MODE_UNKNOWN)
+				return 0;
+			st->n = table_index;
+			scantable(as_tab);
+			if(table_index != 0)
+				return 0;
+			st->a = c_chan();
+			return st->a >= 0 && st->b >= 0 && check_statement_end();
+		case KW_CLOSE:
+			st->op = S_CLOSE;
+			if(check_statement_end())
+				return 1;
+			while(1)
+			{
+				e = c_chan();
+				if(e < 0)
+					return 0;
+				if(st->a < 0)
+					st->a = e;
+				else
+					cmp_node[tail].b = e;
+				tail = e;
+				if(*txtpos != ',')
+					break;
+				txtpos++;
+			}
+			return check_statement_end();
+		case KW_MAT:
+			st->op = S_MAT;
+			scantable(fill_tab);
+			if(table_index == 0)
+			{
+				e = getarray();
+				if(e < 0 || *txtpos != ',')
+					return 0;
+				txtpos++;
+				st->n = st->a = st->b = e;
+				st->d = 'f';
+				st->c = c_value();
+				if(st->c < 0)
+					return 0;
+				return check_statement_end();
+			}
+			e = getarray();
+			if(e < 0 || *txtpos != '=')
+				return 0;
+			st->n = e;
+			txtpos++;
+			st->a = st->b = getarray();
+			if(st->a < 0)
+				return 0;
+			st->d = 'c';
+			if(check_statement_end())
+				return 1;
+			st->d = *txtpos;
+			if(st->d != '+' && st->d != '-' && st->d != '*')
+				return 0;
+			txtpos++;
+			e = getarray();
+			if(e < 0)
+			{
+				/* a scalar multiplier */
+				if(st->d != '*')
+					return 0;
+				st->d = 's';
+				st->c = c_value();
+				if(st->c < 0)
+					return 0;
+				return check_statement_end();
+			}
+			st->b = e;
+			return check_statement_end();
+		case KW_SORT:
+			st->op = S_SORT;
+			e = getarray();
+			if(e < 0 || *txtpos != ',')
+				return 0;
+			st->n = e;
+			txtpos++;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			if(*txtpos == ',')
+			{
+				txtpos++;
+				scantable(desc_tab);
+				if(table_index != 0)
+					return 0;
+				st->d = 1;
+			}
+			return check_statement_end();
+		case KW_MEMCPY:
+		case KW_MEMSET:
+			st->op = table_index == KW_MEMCPY ? S_MEMCPY : S_MEMSET;
+			for(i=0; i<3; i++)
+			{
+				if(i > 0)
+				{
+					if(*txtpos != ',')
+						return 0;
+					txtpos++;
+				}
+				e = c_value();
+				if(e < 0)
+					return 0;
+				if(i == 0)
+					st->a = e;
+				else if(i == 1)
+					st->b = e;
+				else
+					st->c = e;
+			}
+			return check_statement_end();
+		case KW_RANDOMIZE:
+			st->op = S_RANDOMIZE;
+			if(check_statement_end())
+				return 1;
+			st->a = c_value();
+			if(st->a < 0)
+				return 0;
+			return check_statement_end();
+		case KW_RANDFILL:
+			st->op = S_RANDFILL;
+			st->n = getarray();
+			for(i=0; i<2; i++)
+			{
+				if(st->n < 0 || *txtpos != ',')
+					return 0;
+				txtpos++;
+				e = c_value();
+				if(e < 0)
+					return 0;
+				if(i == 0)
+					st->a = e;
+				else
+					st->b = e;
+			}
+			return check_statement_end();
+	}
+	return 0;
+}
+
+/* first statement of the line at text offset line or later */
+short int c_findstmt(line)
+unsigned short line;
+{
+	short int lo = 0;
+	short int hi = cmp_stmts;
+	short int mid;
+
+	while(lo < hi)
+	{
+		mid = (lo+hi)/2;
+		if(cmp_stmt[mid].line < line)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Compile the whole program into cmp_stmt[]. Statements that can't be
+ * compiled are kept as S_TEXT; nothing after one on the same line is
+ * compiled. Returns the number of statements, or -1 if the program
+ * doesn't fit.
+ */
+short int compile()
+{
+	uchar *line;
+	struct cstmt *st;
+	short int first;
+	short int i;
+
+	cmp_nodes = 0;
+	cmp_stmts = 0;
+	cmp_full = 0;
+	for(line = pgm_start; line != pgm_end; line += line[sizeof(LINENUM)])
+	{
+		first = cmp_stmts;
+		txtpos = line+sizeof(LINENUM)+sizeof(char);
+		while(1)
+		{
+			if(cmp_stmts >= CMP_STMTS)
+				return -1;
+			st = cmp_stmt + cmp_stmts++;
+			st->op = S_TEXT;
+			st->n = 0;
+			st->a = st->b = st->c = st->d = -1;
+			st->target = -1;
+			st->line = line - pgm_start;
+			st->txt = txtpos - pgm_start;
+			if(!c_statement(st) || cmp_full) {
+				/* a PRINT has printed what comes before the error */
+				if(st->op != S_PRINT || cmp_full)
+					st->a = st->b = -1;
+				st->op = S_TEXT;
+				st->n = cmp_fail;
+				st->end = txtpos - pgm_start;
+				break;
+			}
+			st->end = txtpos - pgm_start;
+
+			/* the rest of an IF line runs straight on from the condition */
+			if(st->op == S_IF)
+				continue;
+			if(st->op == S_GOTO || st->op == S_GOSUB || st->op == S_RETURN
+					|| st->op == S_REM || st->op == S_END || st->op == S_STOP
+					|| st->op == S_BYE || st->op == S_FOR || st->op == S_PARFOR)
+				break;
+			while(*txtpos == ':')
+				txtpos++;
+			ignore_blanks();
+			if(*txtpos == NL)
+				break;
+		}
+		for(i=first; i<cmp_stmts; i++)
+			cmp_stmt[i].next_line = cmp_stmts;
+		if(cmp_full)
+			return -1;
+	}
+
+	/* where constant GOTOs and GOSUBs go */
+	for(i=0; i<cmp_stmts; i++)
+	{
+		st = cmp_stmt + i;
+		if((st->op == S_GOTO || st->op == S_GOSUB) && cmp_node[st->a].op == X_NUM)
+		{
+			linenum = cmp_node[st->a].val;
+			st->target = c_findstmt(findline() - pgm_start);
+		}
+	}
+	return cmp_stmts;
+}
+
+/***************************************************************************/
+/* Walk up the stack frames from sp to the one a NEXT var acts on, or with
+ * var 0 the one a RETURN does, skipping the others. Returns 0 if there
+ * isn't one, or the first frame it can't make sense of.
+ */
+uchar *find_frame(var)
+uchar var;
+{
+	uchar *f = sp;
+
+	while(f < memory+sizeof(memory)-1)
+	{
+		STAT(stat_frames++);
+		switch(f[0])
+		{
+			case STACK_GOSUB_FLAG:
+				if(var == 0)
+					return f;
+				/* This is not the loop you are looking for... so Walk back up the stack */
+				f += sizeof(struct stack_gosub_frame);
+				break;
+			case STACK_FOR_FLAG:
+				if(var != 0 && var == ((struct stack_for_frame *)f)->for_var)
+					return f;
+				f += sizeof(struct stack_for_frame);
+				break;
+			default:
+				return f;
+		}
+	}
+	return 0;
+}
+
+/* the error report for a syntax error at txtpos in current_line */
+voidret syntax_listing()
+{
+	printmsg(syntaxmsg);
+	if(current_line != 0)  /* smbaker was typecast to vd ptr */
+	{
+       uchar tmp = *txtpos;
+		   if(*txtpos != NL)
+				*txtpos = '^';
+           list_line = current_line;
+           printline();
+           *txtpos = tmp;
+	}
+    put_nl();
+}
+
+/***************************************************************************/
+voidret loop(autorun)
+uchar autorun;
+{
+	uchar pchan;  /* file channel a PRINT is writing to, 0 for the console */
+	uchar jit_k;  /* where to carry on after machine code has run, JIT_* */
+	uchar par;    /* the FOR being run is a PARFOR */
+
+  if (autorun)
+		goto run;
+
+warmstart:
+	prof_stop();
+	stats_run = 0;
+	if(ir_verbose)
+		ir_counts();  /* the end of a run */
+  if (autorun) {
+		/* autorun means autoexit when we're done */
+		return 0;
+	}
+	/* this signifies that it is running in 'direct' mode. */
+	current_line = 0;
+	sp = top_sp;
+	printmsg(okmsg);
+
+prompt:
+	prof_stop();
+	stats_run = 0;
+	if(ir_verbose)
+		ir_counts();
+  switch (procline()) {
+		case PROCLINE_BADLINE:
+		  goto badline;
+		case PROCLINE_DIRECT:
+		  goto direct;
+		case PROCLINE_EOF:
+			if (at_eof)
+				return 0;  /* nothing more to read; same as BYE */
+			goto prompt;
+		/* PROCLINE_OKAY */
+		/* PROCLINE_DELETE */
+		default:
+		  goto prompt;			
+	}
+
+unimplemented:
+	printmsg(unimplimentedmsg);
+	goto prompt;
+
+badline:	
+	printmsg(badlinemsg);
+	goto prompt;
+
+invalidexpr:
+	printmsg(invalidexprmsg);
+	goto prompt;
+
+ioerror:
+	printmsg(iomsg);
+	goto prompt;
+
+syntaxerror:
+	syntax_listing();
+	goto prompt;
+
+stackstuffed:	
+	printmsg(stackstuffedmsg);
+	goto warmstart;
+
+nomem:	
+	printmsg(nomemmsg);
+	goto warmstart;
+
+outofdata:
+	printmsg(nodatamsg);
+	goto warmstart;
+
+endoffile:
+	printmsg(eofmsg);
+	goto warmstart;
+
+overquota:
+	/* untrusted runs are not allowed to drop back to the prompt */
+	printmsg(quota_msg);
+	return 0;
+
+jit_resume:
+	if(jit_k == JIT_STMT)
+		goto interperateAtTxtpos;
+	if(jit_k == JIT_LINE)
+		goto execline;
+
+run_next_statement:
+	while(*txtpos == ':')
+		txtpos++;
+	ignore_blanks();
+	if(*txtpos == NL)
+		goto execnextline;
+	goto interperateAtTxtpos;
+
+direct: 
+	txtpos = LINEBUF;
+	if(*txtpos == NL)
+		goto prompt;
+	quota_reset();
+
+interperateAtTxtpos:
+	STAT(stat_stmts++);
+	if(--quota_tick < 0 && quota_check())
+		goto overquota;
+
+        if(breakcheck())
+        {
+          printmsg(breakmsg);
+          goto warmstart;
+        }
+
+	scantable(keywords);
+	ignore_blanks();
+	STAT(stat_kw[table_index]++);
+
+	switch(table_index)
+	{
+		case KW_LIST:
+			goto list;
+		case KW_LOAD:
+		  goto load;
+		case KW_NEW:
+			if(txtpos[0] != NL)
+				goto syntaxerror;
+			pgm_end = pgm_start;
+			pgm_changed();
+			clear();
+			goto prompt;
+		case KW_RUN:
+			goto run;
+		case KW_SAVE:
+			goto save;
+		case KW_NEXT:
+			goto next;
+		case KW_LET:
+			goto assignment;
+		case KW_IF:
+			{
+			short int val;
+			exp_error = 0;
+			val = expression();
+			if(exp_error || *txtpos == NL)
+				goto invalidexpr;
+			if(val != 0)
+				goto interperateAtTxtpos;
+			goto execnextline;
+			}
+		case KW_GOTO:
+			exp_error = 0;
+			linenum = expression();
+			if(exp_error || *txtpos != NL)
+				goto invalidexpr;
+			{
+				uchar *from = current_line;
+				current_line = findline();
+				/* a GOTO back may close a hot loop, see jit.c */
+				if(!no_jit && !stats_run && from != 0 && current_line <= from)
+				{
+					jit_k = jit_goto(from, current_line);
+					if(jit_k != JIT_NO)
+						goto jit_resume;
+				}
+			}
+			goto execline;
+
+		case KW_GOSUB:
+			goto gosub;
+		case KW_RETURN:
+			goto gosub_return; 
+		case KW_REM:	
+			goto execnextline;	/* Ignore line completely */
+		case KW_FOR:
+		case KW_PARFOR:
+			par = table_index == KW_PARFOR;
+			goto forloop;
+		case KW_INPUT:
+			goto input; 
+		case KW_PRINT:
+			goto print;
+		case KW_POKE:
+			goto do_poke;
+		case KW_STOP:
+		  printmsg(breakmsg);
+			/* fallthrough */
+		case KW_END:
+			/* This is the easy way to end - set the current line to the end of program attempt to run it */
+			if(txtpos[0] != NL)
+				goto syntaxerror;
+			current_line = pgm_end;
+			goto execline;
+		case KW_BYE:
+		case KW_SYSTEM:
+			/* Leave the basic interperater */
+			return 0;
+		case KW_OUT:
+		  goto do_outp;
+    case KW_SLEEP:
+			goto sleep;
+		case KW_CLEAR:
+		  goto do_clear;
+		case KW_DIM:
+		  goto do_dim;
+		case KW_DATA:
+			goto execnextline;	/* values were collected at RUN */
+		case KW_READ:
+			goto read;
+		case KW_RESTORE:
+			goto restore;
+		case KW_OPEN:
+			goto do_open;
+		case KW_CLOSE:
+			goto do_close;
+		case KW_MAT:
+			goto mat;
+		case KW_SORT:
+			goto sort;
+		case KW_MEMCPY:
+		case KW_MEMSET:
+			goto memblock;
+		case KW_RANDOMIZE:
+			goto do_randomize;
+		case KW_RANDFILL:
+			goto randfill;
+		case KW_STATS:
+			if(txtpos[0] != NL)
+				goto syntaxerror;
+			stats_show();
+			STAT(if(current_line == 0) stats_next = 1);
+			goto run_next_statement;
+    case KW_DEFAULT:
+			goto assignment;
+		default:
+			break;
+	}
+	
+run:
+	current_line = pgm_start;
+	quota_reset();
+	stats_reset();
+	chan_close(0);
+	switch(build_image(0))
+	{
+		case IMAGE_SYNTAX:
+			goto syntaxerror;
+		case IMAGE_NOMEM:
+			goto nomem;
+	}
+	/* compile and optimize the program, see ir.c */
+	if(!no_ir && ir_compile() && ir_verbose)
+		ir_report();
+#ifndef NOSTATS
+	/* STATS counts the statements run, and compiled code doesn't */
+	stats_run = cmp_stats || stats_exit || stats_next;
+	stats_next = 0;
+	stats_part = !stats_run && (!no_ir || !no_jit);
+#endif
+	prof_start();
+	goto execline;
+
+execnextline:
+	if(current_line == 0)		/* Processing direct commands? smbaker: was typecast to vdptr */
+		goto prompt;
+	current_line +=	 current_line[sizeof(LINENUM)];
+
+execline:
+  	if(current_line == pgm_end) /* Out of lines to run */
+		goto warmstart;
+	txtpos = current_line+sizeof(LINENUM)+sizeof(char);
+	if(!no_ir && !stats_run)
+	{
+		jit_k = ir_line(current_line);
+		if(jit_k != JIT_NO)
+			goto jit_resume;
+	}
+	goto interperateAtTxtpos;
+
+input:
+	{
+		short int value;
+		uchar *var;
+		uchar bytes;
+		uchar *inp;        /* position in the typed line */
+		uchar *linevars;   /* first variable filled from the current line */
+
+		ignore_blanks();
+		if(*txtpos == '#')
+			goto input_file;
+		linevars = txtpos;
+again:
+		if(!getln('?'))
+			goto warmstart;
+		inp = LINEBUF;
+		txtpos = linevars;  /* getln() used txtpos */
+
+		while(1)
+		{
+			exp_error = 0;
+			var = getvar(&bytes);
+			if(var == 0) {
+				if(exp_error)
+					goto invalidexpr;
+				goto syntaxerror;
+			}
+
+			inp = getnum(inp, &value);
+			if(inp == 0)
+			{
+				printmsg(badinputmsg);
+				goto again;
+			}
+			storevar(var, bytes, value);
+
+			ignore_blanks();
+			if(*txtpos != ',')
+				break;
+			txtpos++;
+			ignore_blanks();
+
+			/* the next value comes from this line, or from a new one if it's used up */
+			if(*inp == ',')
+				inp++;
+			else if(*inp == NL)
+			{
+				linevars = txtpos;
+				goto again;
+			}
+			else
+			{
+				printmsg(badinputmsg);
+				goto again;
+			}
+		}
+
+		if(!check_statement_end())
+			goto syntaxerror;
+		if(*inp != NL)
+		{
+			/* more values than variables */
+			printmsg(badinputmsg);
+			goto again;
+		}
+		goto run_next_statement;
+	}
+
+input_file:
+	{
+		/* INPUT #n, var, ... reads whole lines; values may be spread over
+		 * several lines, anything left on the last one is skipped.
+		 */
+		uchar chan;
+		short int value;
+		uchar *var;
+		uchar bytes;
+		uchar *inp = 0;
+		uchar *buf = LINEBUF;  /* where the lines of the file go */
+
+		/* a typed line is in LINEBUF, so put them after it */
+		if(current_line == 0)
+		{
+			while(*buf != NL)
+				buf++;
+			buf++;
+		}
+
+		chan = getchan();
+		if(chan == 0 || *txtpos != ',')
+			goto syntaxerror;
+		txtpos++;
+		ignore_blanks();
+
+		while(1)
+		{
+			exp_error = 0;
+			var = getvar(&bytes);
+			if(var == 0) {
+				if(exp_error)
+					goto invalidexpr;
+				goto syntaxerror;
+			}
+
+			if(inp == 0 || *inp == NL)
+			{
+				if(!chan_getln(chan, buf, sp - buf - MINFREE))
+					goto endoffile;
+				inp = buf;
+			}
+			inp = getnum(inp, &value);
+			if(inp == 0 || (*inp != ',' && *inp != NL))
+			{
+				printmsg(badinputmsg);
+				goto warmstart;
+			}
+			if(*inp == ',')
+				inp++;
+			storevar(var, bytes, value);
+
+			ignore_blanks();
+			if(*txtpos != ',')
+				break;
+			txtpos++;
+			ignore_blanks();
+		}
+		if(!check_statement_end())
+			goto syntaxerror;
+		goto run_next_statement;
+	}
+
+do_open:
+	{
+		uchar mode;
+		uchar chan;
+
+		if(!get_quoted_string(fn))
+			goto syntaxerror;
+		scantable(for_tab);
+		if(table_index != 0)
+			goto syntaxerror;
+		scantable(mode_tab);
+		if(table_index == MODE_UNKNOWN)
+			goto syntaxerror;
+		mode = table_index;
+		scantable(as_tab);
+		if(table_index != 0)
+			goto syntaxerror;
+		chan = getchan();
+		if(chan == 0 || !check_statement_end())
+			goto syntaxerror;
+		if(!chan_open(chan, fn, mode == MODE_INPUT ? 'r' : mode == MODE_OUTPUT ? 'w' : 'a'))
+			goto ioerror;
+		goto run_next_statement;
+	}
+
+do_close:
+	/* CLOSE #n, or CLOSE on its own for all channels */
+	if(check_statement_end())
+	{
+		chan_close(0);
+		goto run_next_statement;
+	}
+	while(1)
+	{
+		uchar chan = getchan();
+		if(chan == 0)
+			goto syntaxerror;
+		chan_close(chan);
+		if(*txtpos != ',')
+			break;
+		txtpos++;
+	}
+	if(!check_statement_end())
+		goto syntaxerror;
+	goto run_next_statement;
+
+mat:
+	{
+		/* MAT A = B, MAT A = B + C, B - C, B * C (elementwise),
+		 * MAT A = B * k and MAT FILL A, k. Operands must have at least
+		 * as many elements as A; bounds are checked once per statement.
+		 */
+		short int dst, src, src2;
+		short int k;
+		uchar op;
+
+		scantable(fill_tab);
+		if(table_index == 0)
+		{
+			dst = getarray();
+			if(dst < 0 || *txtpos != ',')
+				goto syntaxerror;
+			txtpos++;
+			exp_error = 0;
+			k = expression();
+			if(exp_error)
+				goto invalidexpr;
+			if(!check_statement_end())
+				goto syntaxerror;
+			if(!mat_fits(dst, dst, dst))
+				goto matbounds;
+			mat_run('f', dst, dst, dst, k);
+			goto run_next_statement;
+		}
+
+		dst = getarray();
+		if(dst < 0 || *txtpos != '=')
+			goto syntaxerror;
+		txtpos++;
+		src = getarray();
+		if(src < 0)
+			goto syntaxerror;
+		if(!mat_fits(dst, src, src))
+			goto matbounds;
+
+		if(check_statement_end())
+		{
+			mat_run('c', dst, src, src, 0);
+			goto run_next_statement;
+		}
+
+		op = *txtpos;
+		if(op != '+' && op != '-' && op != '*')
+			goto syntaxerror;
+		txtpos++;
+		src2 = getarray();
+		if(src2 < 0)
+		{
+			/* not an array, so a scalar multiplier */
+			if(op != '*')
+				goto syntaxerror;
+			exp_error = 0;
+			k = expression();
+			if(exp_error)
+				goto invalidexpr;
+			if(!check_statement_end())
+				goto syntaxerror;
+			mat_run('s', dst, src, src, k);
+			goto run_next_statement;
+		}
+		if(!check_statement_end())
+			goto syntaxerror;
+		if(!mat_fits(dst, src, src2))
+			goto matbounds;
+		mat_run(op, dst, src, src2, 0);
+		goto run_next_statement;
+	}
+
+matbounds:
+	printmsg(boundsmsg);
+	goto invalidexpr;
+
+sort:
+	{
+		/* SORT A, n [, DESC] sorts A(0) to A(n-1) */
+		short int name;
+		unsigned short n;
+		uchar desc = 0;
+
+		name = getarray();
+		if(name < 0 || *txtpos != ',')
+			goto syntaxerror;
+		txtpos++;
+		exp_error = 0;
+		n = expression();
+		if(exp_error)
+			goto invalidexpr;
+		if(*txtpos == ',')
+		{
+			txtpos++;
+			scantable(desc_tab);
+			if(table_index != 0)
+				goto syntaxerror;
+			desc = 1;
+		}
+		if(!check_statement_end())
+			goto syntaxerror;
+		if(!sort_run(name, n, desc))
+			goto matbounds;
+		goto run_next_statement;
+	}
+
+do_randomize:
+	{
+		/* RANDOMIZE seed, or RANDOMIZE alone to seed from the host */
+		short int value;
+
+		if(check_statement_end())
+		{
+			randomize(host_seed());
+			goto run_next_statement;
+		}
+		exp_error = 0;
+		value = expression();
+		if(exp_error)
+			goto invalidexpr;
+		if(!check_statement_end())
+			goto syntaxerror;
+		randomize(value);
+		goto run_next_statement;
+	}
+
+randfill:
+	{
+		/* RANDFILL A, n, range fills A(0) to A(n-1) with RAND(range) */
+		short int name;
+		short int args[2];
+		unsigned int i;
+
+		name = getarray();
+		exp_error = 0;
+		for(i=0; i<2; i++)
+		{
+			if(name < 0 || *txtpos != ',')
+				goto syntaxerror;
+			txtpos++;
+			args[i] = expression();
+			if(exp_error)
+				goto invalidexpr;
+		}
+		if(!check_statement_end())
+			goto syntaxerror;
+		if(!randfill_run(name, args[0], args[1]))
+			goto matbounds;
+		goto run_next_statement;
+	}
+
+memblock:
+	{
+		/* MEMCPY dst, src, n and MEMSET dst, value, n */
+		uchar kw = table_index;
+		short int args[3];
+		int i;
+
+		exp_error = 0;
+		for(i=0; i<3; i++)
+		{
+			if(i > 0)
+			{
+				if(*txtpos != ',')
+					goto syntaxerror;
+				txtpos++;
+			}
+			args[i] = expression();
+			if(exp_error)
+				goto invalidexpr;
+		}
+		if(!check_statement_end())
+			goto syntaxerror;
+		if(kw == KW_MEMCPY)
+			i = mem_copy(args[0], args[1], args[2]);
+		else
+			i = mem_set(args[0], (uchar)args[1], args[2]);
+		if(!i)
+			goto matbounds;
+		goto run_next_statement;
+	}
+
+read:
+	if(!image_ok)
+	{
+		switch(build_image(1))
+		{
+			case IMAGE_SYNTAX:
+				goto syntaxerror;
+			case IMAGE_NOMEM:
+				goto nomem;
+		}
+	}
+	while(1)
+	{
+		uchar *var;
+		uchar bytes;
+
+		exp_error = 0;
+		var = getvar(&bytes);
+		if(var == 0) {
+			if(exp_error)
+				goto invalidexpr;
+			goto syntaxerror;
+		}
+		if(data_ptr >= data_count)
+			goto outofdata;
+		storevar(var, bytes, data_pool[data_ptr++]);
+
+		ignore_blanks();
+		if(*txtpos != ',')
+			break;
+		txtpos++;
+		ignore_blanks();
+	}
+	if(!check_statement_end())
+		goto syntaxerror;
+	goto run_next_statement;
+
+restore:
+	if(!image_ok)
+	{
+		switch(build_image(1))
+		{
+			case IMAGE_SYNTAX:
+				goto syntaxerror;
+			case IMAGE_NOMEM:
+				goto nomem;
+		}
+	}
+	if(check_statement_end())
+	{
+		data_ptr = 0;
+		goto run_next_statement;
+	}
+	exp_error = 0;
+	linenum = expression();
+	if(exp_error)
+		goto invalidexpr;
+	if(!check_statement_end())
+		goto syntaxerror;
+	data_ptr = data_find(linenum);
+	goto run_next_statement;
+
+forloop:
+	{
+		uchar var;
+		short int initial, step, terminal;
+
+		if(*txtpos < 'A' || *txtpos > 'Z')
+			goto syntaxerror;
+		var = *txtpos;
+		txtpos++;
+		
+		scantable(relop_tab);
+		if(table_index != RELOP_EQ)
+			goto syntaxerror;
+
+		exp_error = 0;
+		initial = expression();
+		if(exp_error)
+			goto invalidexpr;
+	
+		scantable(to_tab);
+		if(table_index != 0)
+			goto syntaxerror;
+	
+		terminal = expression();
+		if(exp_error)
+			goto invalidexpr;
+	
+		scantable(step_tab);
+		if(table_index == 0)
+		{
+			step = expression();
+			if(exp_error)
+				goto invalidexpr;
+		}
+		else
+			step = 1;
+		if(!check_statement_end())
+			goto syntaxerror;
+
+
+		if(!exp_error && *txtpos == NL)
+		{
+			struct stack_for_frame *f;
+
+			/* a PARFOR whose iterations can run side by side, see ir.c;
+			 * otherwise it is run as a FOR
+			 */
+			if(par && !no_ir && !stats_run)
+			{
+				jit_k = ir_parfor(var-'A', initial, terminal, step);
+				if(jit_k == JIT_SHARED)
+				{
+					printmsg(sharedmsg);
+					goto prompt;
+				}
+				if(jit_k == JIT_PARBODY)
+				{
+					printmsg(parbodymsg);
+					goto prompt;
+				}
+				if(jit_k != JIT_NO)
+					goto jit_resume;
+			}
+			if(sp + sizeof(struct stack_for_frame) < stack_limit)
+				goto nomem;
+
+			sp -= sizeof(struct stack_for_frame);
+			STAT_PEAK();
+			f = (struct stack_for_frame *)sp;
+			((short int *)variables_table)[var-'A'] = initial;
+			f->frame_type = STACK_FOR_FLAG;
+			f->for_var = var;
+			f->terminal = terminal;
+			f->step     = step;
+			f->sff_txtpos   = txtpos;
+			f->sff_current_line = current_line;
+			goto run_next_statement;
+		}
+	}
+	goto syntaxerror;
+
+gosub:
+	exp_error = 0;
+	linenum = expression();
+	if(exp_error)
+		goto invalidexpr;
+	if(!exp_error && *txtpos == NL)
+	{
+		struct stack_gosub_frame *f;
+		if(sp + sizeof(struct stack_gosub_frame) < stack_limit)
+			goto nomem;
+
+		sp -= sizeof(struct stack_gosub_frame);
+		STAT_PEAK();
+		f = (struct stack_gosub_frame *)sp;
+		f->frame_type = STACK_GOSUB_FLAG;
+		f->sgf_txtpos = txtpos;
+		f->sgf_current_line = current_line;
+		current_line = findline();
+		goto execline;
+	}
+	goto syntaxerror;
+
+next:
+	/* Fnd the variable name */
+	ignore_blanks();
+	if(*txtpos < 'A' || *txtpos > 'Z')
+		goto syntaxerror;
+	txtpos++;
+	if(!check_statement_end())
+		goto syntaxerror;
+	
+gosub_return:
+	/* Now walk up the stack frames and find the frame we want, if present */
+	tempsp = find_frame(table_index == KW_RETURN ? 0 : txtpos[-1]);
+	if(tempsp == 0)
+		goto syntaxerror;  /* Didn't find the variable we've been looking for */
+	if(tempsp[0] != STACK_GOSUB_FLAG && tempsp[0] != STACK_FOR_FLAG)
+		goto stackstuffed;
+	if(table_index == KW_RETURN)
+	{
+		struct stack_gosub_frame *f = (struct stack_gosub_frame *)tempsp;
+		current_line	= f->sgf_current_line;
+		txtpos			= f->sgf_txtpos;
+		sp += sizeof(struct stack_gosub_frame);
+		goto run_next_statement;
+	}
+	else
+	{
+		struct stack_for_frame *f = (struct stack_for_frame *)tempsp;
+		short int *varaddr = ((short int *)variables_table) + txtpos[-1] - 'A'; 
+		*varaddr = *varaddr + f->step;
+		/* Use a different test depending on the sign of the step increment */
+		if((f->step > 0 && *varaddr <= f->terminal) || (f->step < 0 && *varaddr >= f->terminal))
+		{
+			/* We have to loop so don't pop the stack */
+			sp = tempsp; /* SMBAKER: pop any stack pointers for inner loops */
+			if(!no_jit && !stats_run)
+			{
+				jit_k = jit_loop(tempsp);
+				if(jit_k != JIT_NO)
+					goto jit_resume;
+			}
+			txtpos = f->sff_txtpos;
+			current_line = f->sff_current_line;
+			goto run_next_statement;
+		}
+		/* We've run to the end of the loop. drop out of the loop, popping the stack */
+		sp = tempsp + sizeof(struct stack_for_frame);
+		goto run_next_statement;
+	}
+
+assignment:
+	{
+		short int value;
+		uchar *var;
+		uchar bytes;
+
+		exp_error = 0;
+		var = getvar(&bytes);
+		if(var == 0) {
+			if(exp_error)
+				goto invalidexpr;
+			goto syntaxerror;
+		}
+
+		ignore_blanks();
+
+		if (*txtpos != '=')
+			goto syntaxerror;
+		txtpos++;
+		ignore_blanks();
+		exp_error = 0;
+		value = expression();
+		if(exp_error)
+			goto invalidexpr;
+		/* Check that we are at the end of the statement */
+		if(!check_statement_end())
+			goto syntaxerror;
+		storevar(var, bytes, value);
+	}
+	goto run_next_statement;
+
+sleep:
+        {
+                short int value;
+                exp_error = 0;
+		value = expression();
+		if(exp_error)
+  	            goto invalidexpr;
+                /* delay(value); */
+        }
+        goto run_next_statement;
+
+do_clear:
+  clear();
+	goto run_next_statement;
+
+do_dim:
+  {
+		uchar varnum;
+		unsigned int arrsize;
+		unsigned int cols;
+		uchar esz;
+    if(*txtpos < 'A' || *txtpos > 'Z')
+	    goto syntaxerror;
+		varnum = *txtpos - 'A';
+		txtpos++;
+
+		/* DIM A%(n) is an array of bytes */
+		esz = VAR_SIZE;
+		if (*txtpos == '%') {
+			esz = 1;
+			txtpos++;
+		}
+
+		ignore_blanks();
+		if (*txtpos != '(')
+		  goto syntaxerror;
+		txtpos++;
+
+		/* DIM A(h,w) is h+1 rows of w+1 elements */
+		exp_error = 0;
+		arrsize = expression();
+		cols = 0;
+		if (*txtpos == ',') {
+			txtpos++;
+			cols = expression() + 1;
+		}
+		if (exp_error)
+			goto invalidexpr;
+		if (*txtpos != ')')
+			goto syntaxerror;
+		txtpos++;
+		if(!check_statement_end())
+			goto syntaxerror;
+
+		if(!dim_run(varnum, arrsize, cols, esz))
+			goto nomem;
+
+		goto run_next_statement;
+	}
+
+do_poke:
+	{
+		short int value;
+		uchar *address;
+
+		/* Work out where to put it */
+		exp_error = 0;
+		value = expression();
+		if(exp_error)
+			goto invalidexpr;
+		address = (uchar *)value;
+
+		/* check for a comma */
+		ignore_blanks();
+		if (*txtpos != ',')
+			goto syntaxerror;
+		txtpos++;
+		ignore_blanks();
+
+		/* Now get the value to assign */
+		exp_error = 0;
+		value = expression();
+		if(exp_error)
+			goto invalidexpr;
+		poke(address, (uchar) value);
+		/* Check that we are at the end of the statement */
+		if(!check_statement_end())
+			goto syntaxerror;
+	}
+	goto run_next_statement;
+
+do_outp:
+	{
+		short int value;
+		uchar *address;
+
+		/* Work out where to put it */
+		exp_error = 0;
+		value = expression();
+		if(exp_error)
+			goto invalidexpr;
+		address = (uchar *)value;
+
+		/* check for a comma */
+		ignore_blanks();
+		if (*txtpos != ',')
+			goto syntaxerror;
+		txtpos++;
+		ignore_blanks();
+
+		/* Now get the value to assign */
+		exp_error = 0;
+		value = expression();
+		if(exp_error)
+			goto invalidexpr;
+		outp(address, (uchar) value);
+		STAT(stat_ports++);
+		/* Check that we are at the end of the statement */
+		if(!check_statement_end())
+			goto syntaxerror;
+	}
+	goto run_next_statement;	
+
+list:
+	linenum = testnum(); /* Retuns 0 if no line found. */
+
+	/* Should be EOL */
+	if(txtpos[0] != NL)
+		goto syntaxerror;
+
+	printpgm(linenum);
+	goto warmstart;
+
+save:
+  if (!get_quoted_string(fn))
+	  goto syntaxerror;
+	if (!open_write(fn)) 
+	  goto ioerror;
+  printpgm(0);
+	close_file();
+	goto warmstart;
+
+load:
+  if (!get_quoted_string(fn))
+	  goto syntaxerror;
+	if (!open_read(fn))
+	  goto ioerror;
+  loadpgm();
+	close_file();
+	goto warmstart;
+
+print:
+	/* PRINT #n, ... writes to file channel n. The channel is selected
+	 * only while text is being output, so error messages from evaluating
+	 * the expressions still go to the console.
+	 */
+	pchan = 0;
+	if(*txtpos == '#')
+	{
+		pchan = getchan();
+		if(pchan == 0 || !select_output(pchan))
+			goto ioerror;
+		select_output(0);
+		if(*txtpos == ',')
+		{
+			txtpos++;
+			ignore_blanks();
+		}
+		else if(!check_statement_end())
+			goto syntaxerror;
+	}
+
+	/* If we have an empty list then just put out a NL */
+	if(*txtpos == ':' )
+	{
+		select_output(pchan);
+        put_nl();
+		select_output(0);
+		txtpos++;
+		goto run_next_statement;
+	}
+	if(*txtpos == NL)
+	{
+		select_output(pchan);
+		put_nl();
+		select_output(0);
+		goto execnextline;
+	}
+
+	while(1)
+	{
+		ignore_blanks();
+		select_output(pchan);
+		if(print_quoted_string())
+		{
+			select_output(0);
+		}
+		else if(*txtpos == '"' || *txtpos == '\'')
+		{
+			select_output(0);
+			goto syntaxerror;
+		}
+		else
+		{
+			short int e;
+			select_output(0);
+			exp_error = 0;
+			e = expression();
+			if(exp_error)
+				goto invalidexpr;
+			select_output(pchan);
+			printnum(e);
+			select_output(0);
+		}
+
+		/* At this point we have three options, a comma or a new line */
+		if(*txtpos == ',')
+			txtpos++;	/* Skip the comma and move onto the next */
+		else if(txtpos[0] == ';' && (txtpos[1] == NL || txtpos[1] == ':'))
+		{
+			txtpos++; /* This has to be the end of the print - no newline */
+			break;
+		}
+		else if(check_statement_end())
+		{
+			select_output(pchan);
+			put_nl();	/* The end of the print statement */
+			select_output(0);
+			break;
+		}
+		else
+			goto syntaxerror;	
+	}
+	goto run_next_statement;
+}
+
+/***********************************************************/
+uchar breakcheck() {
+  if(kbhit())
+    return getch() == CTRLC;
+  else
+    return 0;
+}
+
+/***************************************************************************/
+/* The runtime of programs translated by --emit-c. The program text is
+ * part of the translation and goes into memory[] as if it had been
+ * loaded, so the run image, FRE(), PEEK() and error listings all come
+ * out as they do in the interpreter.
+ */
+const uchar rtusagemsg[] = "usage: program [-a] [-R]";
+
+/* Start a translated program: the options, then what RUN does. Returns
+ * 0 if it can't run.
+ */
+uchar rt_start(argc, argv, text, size)
+int argc;
+char **argv;
+uchar *text;
+unsigned int size;
+{
+	unsigned int i;
+	uchar async = 0;
+
+	for (i=1; i<argc; i++) {
+		if (argv[i][0] == '-' && argv[i][1] == 'a' && argv[i][2] == 0)
+			async = 1;
+		else if (argv[i][0] == '-' && argv[i][1] == 'R' && argv[i][2] == 0)
+			rand_legacy(1);
+		else {
+			printmsg(rtusagemsg);
+			return 0;
+		}
+	}
+
+	lecho = enable_raw_mode();
+	host_natives();
+	initialize();
+	if (async)
+		async_output(1);
+	for (i=0; i<size; i++)
+		pgm_start[i] = text[i];
+	pgm_end = pgm_start + size;
+	pgm_changed();
+
+	current_line = pgm_start;
+	quota_reset();
+	chan_close(0);
+	switch(build_image(0))
+	{
+		case IMAGE_SYNTAX:
+			syntax_listing();
+			return 0;
+		case IMAGE_NOMEM:
+			printmsg(nomemmsg);
+			return 0;
+	}
+	return 1;
+}
+
+/* report an error as the interpreter does; for a syntax error at is the
+ * text offset of the problem
+ */
+voidret rt_error(code, at)
+int code;
+unsigned int at;
+{
+	switch(code)
+	{
+		case RT_SYNTAX:
+			txtpos = pgm_start + at;
+			current_line = pgm_start;
+			while(current_line + current_line[sizeof(LINENUM)] <= txtpos)
+				current_line += current_line[sizeof(LINENUM)];
+			syntax_listing();
+			break;
+		case RT_BOUNDS:
+			printmsg(boundsmsg);
+			/* fallthrough */
+		case RT_INVALID:
+			printmsg(invalidexprmsg);
+			break;
+		case RT_IO:
+			printmsg(iomsg);
+			break;
+		case RT_NOMEM:
+			printmsg(nomemmsg);
+			break;
+		case RT_NODATA:
+			printmsg(nodatamsg);
+			break;
+		case RT_EOF:
+			printmsg(eofmsg);
+			break;
+		case RT_STUFFED:
+			printmsg(stackstuffedmsg);
+			break;
+		case RT_SHARED:
+			printmsg(sharedmsg);
+			break;
+		case RT_PARBODY:
+			printmsg(parbodymsg);
+			break;
+	}
+}
+
+/* a line typed for INPUT, or 0 at the end of input */
+uchar *rt_getln()
+{
+	if(!getln('?'))
+		return 0;
+	return LINEBUF;
+}
+
+/* the next line of file channel chan for INPUT #, or 0 at its end */
+uchar *rt_getfile(chan)
+uchar chan;
+{
+	if(!chan_getln(chan, LINEBUF, sp - LINEBUF - MINFREE))
+		return 0;
+	return LINEBUF;
+}
+
+/* index in lines[] of the first of the n line numbers at or past ln, as
+ * findline()
+ */
+short int rt_line(ln, lines, n)
+unsigned short ln;
+unsigned short *lines;
+short int n;
+{
+	short int lo = 0;
+	short int hi = n;
+	short int mid;
+
+	while(lo < hi)
+	{
+		mid = (lo+hi)/2;
+		if(lines[mid] < ln)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int rt_end()
+{
+	chan_close(0);
+	async_output(0);
+	flush_output();
+	disable_raw_mode();
+	return exit_code;
+}
+
+#ifndef NOMAIN
+/* parse a non-negative decimal command line argument, -1 if malformed */
+long argnum(s)
+char *s;
+{
+	long num = 0;
+	if (s == NULL || *s == '\0')
+		return -1;
+	while (*s) {
+		if (*s < '0' || *s > '9')
+			return -1;
+		num = num*10 + *s - '0';
+		s++;
+	}
+	return num;
+}
+
+/* 1 if s is the --emit-c option */
+uchar emit_opt(s)
+char *s;
+{
+	char *opt = "--emit-c";
+
+	while (*opt && *s == *opt) {
+		s++;
+		opt++;
+	}
+	return *s == 0 && *opt == 0;
+}
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	int i;
+	char *pgm_name = NULL;
+	char *cost_name = NULL;
+	char *trace_name = NULL;
+	uchar trace_mode = 0;
+	uchar async = 0;
+	uchar emit = 0;
+
+	for (i=1; i<argc; i++) {
+		if (argv[i][0] != '-') {
+			pgm_name = argv[i];
+			continue;
+		}
+		switch (argv[i][1]) {
+			case '-':
+				if (!emit_opt(argv[i])) {
+					printmsg(usagemsg);
+					return -1;
+				}
+				emit = 1;
+				break;
+			case 'a':
+				async = 1;
+				break;
+			case 's':
+				stmt_budget = argnum(argv[++i]);
+				break;
+			case 't':
+				time_limit = argnum(argv[++i]) * 1000;
+				break;
+			case 'R':
+				rand_legacy(1);
+				break;
+			case 'I':
+				no_ir = 1;
+				break;
+			case 'J':
+				no_jit = 1;
+				break;
+			case 'v':
+				ir_verbose = 1;
+				break;
+			case 'S':
+				stats_exit = 1;
+				break;
+#ifndef NOSTATS
+			case 'Z':
+				cost_name = argv[++i];
+				if (cost_name == NULL) {
+					printmsg(usagemsg);
+					return -1;
+				}
+				/* fallthrough */
+			case 'z':
+				est_on = 1;
+				break;
+#endif
+			case 'T':
+			case 'P':
+				trace_mode = argv[i][1] == 'T' ? TRACE_RECORD : TRACE_REPLAY;
+				trace_name = argv[++i];
+				if (trace_name == NULL) {
+					printmsg(usagemsg);
+					return -1;
+				}
+				break;
+			case 'p':
+				prof_file = argv[++i];
+				if (prof_file == NULL) {
+					printmsg(usagemsg);
+					return -1;
+				}
+				break;
+			default:
+				printmsg(usagemsg);
+				return -1;
+		}
+		if (stmt_budget < 0 || time_limit < 0) {
+			printmsg(usagemsg);
+			return -1;
+		}
+	}
+
+	/* compiled code doesn't count statements or look at the clock */
+	if (stmt_budget || time_limit)
+		no_jit = no_ir = 1;
+#ifndef NOSTATS
+	/* nor does it go through the costs of the Z8000 estimate */
+	if (est_on)
+		no_jit = no_ir = 1;
+	est_defaults();
+	if (cost_name && !est_load(cost_name)) {
+		printmsg("Failed to load costs");
+		return -1;
+	}
+#endif
+
+	if (emit && pgm_name == NULL) {
+		printmsg(usagemsg);
+		return -1;
+	}
+	if (trace_name && !trace_open(trace_name, trace_mode)) {
+		printmsg("Failed to open trace");
+		return -1;
+	}
+
+	lecho = enable_raw_mode();
+	host_natives();
+	initialize();
+	if (async)
+		async_output(1);
+
+	if (pgm_name) {
+	  if (!open_read(pgm_name)) {
+			printmsg("Failed to load program\n");
+			async_output(0);
+			disable_raw_mode();
+			return -1;
+		}
+    loadpgm();
+	  close_file();
+		if (emit)
+			exit_code = emit_c(pgm_name);  /* translate to C instead */
+		else
+			loop(1);     /* automatically RUN */
+	} else {
+		banner();
+    loop(0);     /* don't acutomatically RUN */
+	}
+
+	chan_close(0);
+	if (stats_exit)
+		stats_show();
+#ifndef NOSTATS
+	else if (est_on) {
+		stats_line("Z8000 cycles        ", est_cycles());
+		stats_line("Z8000 milliseconds  ", est_cycles() / est_khz);
+	}
+#endif
+	if (prof_file && !prof_write())
+		printmsg("Failed to write profile");
+	if (!trace_close())
+		printmsg("Replay didn't follow the trace");
+	async_output(0);
+	flush_output();
+	disable_raw_mode();
+	return exit_code;
+}
+#endif
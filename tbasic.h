@@ -0,0 +1,243 @@
+/*  tbasic.h : the compiled form of a program
+
+ compile() in tbasic.c parses the program text into a list of statements
+ whose expressions are trees of nodes. emitc.c translates it to C, and
+ the code it generates calls back into tbasic.c (built with -DNOMAIN)
+ for everything but the arithmetic and control flow, so a translated
+ program behaves like the interpreted one down to its error messages.
+ ir.c optimizes it and runs it in place of the text where it can, and
+ jit.c turns its hot loops into machine code.
+*/
+
+/* expression nodes; a and b are node numbers, -1 for none */
+#define X_NUM    0   /* the constant val */
+#define X_VAR    1   /* variable n, 0 to 25 */
+#define X_ELEM   2   /* element of array n: A(a), or A(a,b) */
+#define X_FUNC   3   /* built in function n (FUNC_*) of the argument list a */
+#define X_NATIVE 4   /* native function n of the argument list a */
+#define X_ARG    5   /* list cell: item a, rest of the list b; val is the
+                      * text offset just past the item */
+#define X_STR    6   /* quoted string of a characters at text offset val */
+#define X_NOT    7
+#define X_ADD    8
+#define X_SUB    9
+#define X_MUL    10
+#define X_DIV    11
+#define X_MOD    12
+#define X_SHL    13
+#define X_SHR    14
+#define X_GE     15  /* the comparisons are in RELOP_* order */
+#define X_NE     16
+#define X_GT     17
+#define X_EQ     18
+#define X_LE     19
+#define X_LT     20
+#define X_AND    21
+#define X_OR     22
+#define X_XOR    23
+#define X_HOIST  24  /* node a, which loop n of ir.c doesn't change: its
+                      * value is worked out once, in slot val */
+
+struct cnode {
+	uchar op;
+	uchar n;
+	short int val;
+	short int a, b;
+};
+
+/* statements. Fields not listed are unused; expressions are node numbers
+ * and -1 where the statement has none.
+ */
+#define S_TEXT      0   /* can't be compiled: n is how it fails (CE_*), at
+                         * text offset end. A PRINT keeps the channel a and
+                         * items b it gets through first. */
+#define S_LET       1   /* a = b; a is an X_VAR or X_ELEM node */
+#define S_PRINT     2   /* channel a, items b (X_ARG list of X_STR and
+                         * expressions), n set for a trailing ; */
+#define S_IF        3   /* condition a; the rest of the line follows */
+#define S_GOTO      4   /* line a, target the statement if a is constant */
+#define S_GOSUB     5
+#define S_RETURN    6
+#define S_FOR       7   /* variable n = a TO b STEP c */
+#define S_NEXT      8   /* n is the character before the end of the statement,
+                         * the variable letter unless blanks followed it */
+#define S_END       9
+#define S_STOP      10
+#define S_REM       11  /* also DATA */
+#define S_READ      12  /* variable list b */
+#define S_RESTORE   13  /* line a */
+#define S_INPUT     14  /* channel a, variable list b */
+#define S_DIM       15  /* array n (a, b), b is -1 for one dimension; c is
+                         * the element size */
+#define S_POKE      16  /* address a, value b */
+#define S_OUT       17
+#define S_SLEEP     18
+#define S_CLEAR     19
+#define S_BYE       20
+#define S_OPEN      21  /* file name b (X_STR) FOR mode n AS channel a */
+#define S_CLOSE     22  /* channel list a, -1 for all */
+#define S_MAT       23  /* array n = array a op array b, or op k in c; op is
+                         * d, as for mat_run() */
+#define S_SORT      24  /* array n, count a, d set for DESC */
+#define S_MEMCPY    25  /* a, b, c */
+#define S_MEMSET    26
+#define S_RANDOMIZE 27  /* seed a, -1 for host_seed() */
+#define S_RANDFILL  28  /* array n, count a, range b */
+#define S_PARFOR    29  /* as S_FOR, the iterations being independent */
+
+/* how a statement that can't be compiled fails when it is reached */
+#define CE_SYNTAX  1   /* Syntax Error */
+#define CE_INVALID 2   /* Invalid expression */
+#define CE_IO      3   /* IO Error */
+#define CE_DIRECT  4   /* a command, such as LIST or RUN */
+
+struct cstmt {
+	uchar op;
+	uchar n;
+	short int a, b, c, d;
+	short int target;      /* statement a constant GOTO or GOSUB goes to */
+	short int next_line;   /* first statement of the following line */
+	unsigned short line;   /* text offsets from pgm_start: the line, */
+	unsigned short txt;    /* the statement */
+	unsigned short end;    /* and where the interpreter is when it's done */
+};
+
+extern struct cnode cmp_node[CMP_NODES];
+extern struct cstmt cmp_stmt[CMP_STMTS];
+extern short int cmp_nodes;
+extern short int cmp_stmts;
+extern uchar cmp_full;
+
+#define FUNC_PEEK    0
+#define FUNC_ABS     1
+#define FUNC_HIGH    2
+#define FUNC_LOW     3
+#define FUNC_INP     4
+#define FUNC_FRE     5
+#define FUNC_RAND    6
+#define FUNC_EOF     7
+#define FUNC_SEARCH  8
+#define FUNC_MEMSUM  9
+#define FUNC_CRC     10
+#define FUNC_SQR     11
+#define FUNC_SIN     12
+#define FUNC_COS     13
+#define FUNC_ATN     14
+#define FUNC_UNKNOWN 15
+
+#define ONE_Q14 16384   /* 1.0 in the fixed point of SIN(), COS() and ATN() */
+
+/* the stack frames of FOR and GOSUB. In a translated program the
+ * txtpos of a frame holds the number of the line to go back to.
+ */
+struct stack_for_frame {
+	char frame_type;
+	char for_var;
+	short int terminal;
+	short int step;
+	uchar *sff_current_line;
+	uchar *sff_txtpos;
+};
+
+struct stack_gosub_frame {
+	char frame_type;
+	uchar *sgf_current_line;
+	uchar *sgf_txtpos;
+};
+#define STACK_GOSUB_FLAG 'G'
+#define STACK_FOR_FLAG 'F'
+
+/* errors for rt_error() */
+#define RT_SYNTAX  1
+#define RT_INVALID 2
+#define RT_IO      3
+#define RT_NOMEM   4
+#define RT_NODATA  5
+#define RT_EOF     6
+#define RT_STUFFED 7
+#define RT_BOUNDS  8   /* Bounds error, then Invalid expression */
+#define RT_SHARED  9   /* a PARFOR sets a variable its iterations share */
+#define RT_PARBODY 10  /* a PARFOR holds a statement it can't */
+
+/* tbasic.c */
+extern uchar exp_error;
+extern uchar *pgm_start;
+extern uchar *pgm_end;
+extern uchar *image_end;
+extern uchar *variables_table;
+extern uchar *array_table;
+extern uchar *array_sz;
+extern uchar *array_esz;
+extern uchar *array_cols;
+extern uchar *sp;
+extern uchar *top_sp;
+extern short int *data_pool;
+extern unsigned short data_count;
+extern unsigned short data_ptr;
+extern const uchar boundsmsg[];
+extern const uchar badinputmsg[];
+extern const uchar breakmsg[];
+
+short int compile();
+short int c_findstmt();
+uchar *find_frame();
+short int search_run();
+short int sin_deg();
+short int atn_deg();
+short int isqrt();
+unsigned short data_find();
+uchar dim_run();
+voidret mat_run();
+uchar mat_fits();
+uchar sort_run();
+uchar randfill_run();
+voidret printnum();
+voidret printmsg();
+voidret clear();
+uchar *getnum();
+uchar *rt_getln();
+uchar *rt_getfile();
+uchar rt_start();
+voidret rt_error();
+int rt_end();
+short int rt_line();
+
+#ifndef NOSTATS
+extern long stat_stmts;
+extern unsigned short stat_peak;
+#endif
+/* note how deep the stack has got, after pushing a frame */
+#define STAT_PEAK() STAT(if (top_sp - sp > stat_peak) stat_peak = top_sp - sp)
+
+/* emitc.c */
+int emit_c();
+
+/* ir.c */
+uchar ir_compile();
+voidret ir_reset();
+voidret ir_report();
+voidret ir_counts();
+uchar ir_line();
+uchar ir_pfcheck();
+uchar ir_parfor();
+voidret ir_putlong();
+extern short int ir_at;
+
+/* ir_pfcheck(): what can be done with a PARFOR */
+#define PF_OK     0   /* its iterations can run in parallel */
+#define PF_SERIAL 1   /* it has no NEXT, so it runs as a FOR */
+#define PF_SHARED 2   /* RT_SHARED */
+#define PF_BODY   3   /* RT_PARBODY */
+
+/* jit.c: what loop() does after jit_loop(), jit_goto() or ir_line() */
+#define JIT_NO   0   /* nothing ran, carry on interpreting */
+#define JIT_STMT 1   /* carry on at the statement at txtpos */
+#define JIT_NEXT 2   /* the loop is over, carry on after the NEXT at txtpos */
+#define JIT_LINE 3   /* carry on at the start of current_line */
+#define JIT_SHARED 4  /* ir_parfor() only: report RT_SHARED */
+#define JIT_PARBODY 5 /* and RT_PARBODY */
+
+uchar jit_loop();
+uchar jit_goto();
+voidret jit_reset();
+extern uchar *jit_line;
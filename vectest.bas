@@ -0,0 +1,10 @@
+5 PRINT "should print 1 2 51 100 twice, compiled or not"
+10 DIM A(100)
+20 FOR I=1 TO 100
+30 A(I)=PEEK(32566+2*I-2)+1
+40 NEXT I
+50 PRINT A(1), " ", A(2), " ", A(51), " ", A(100)
+60 FOR I=1 TO 100
+70 A(I)=ABS(A(I-1))+1
+80 NEXT I
+90 PRINT A(1), " ", A(2), " ", A(51), " ", A(100)